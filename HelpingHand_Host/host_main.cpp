@@ -0,0 +1,131 @@
+/**
+* Host runner for the HelpingHand glove firmware.
+*
+* Scripts one session against the simulated board (hub picks game mode,
+* user rotates the wrist, pinches and fists, hub reports a collision, then
+* plot mode, then quit), runs the firmware main() through it on the virtual
+* clock, and then times the hot-path functions on their own.
+*/
+#define MBED_HOST_KEEP_MAIN
+#include "mbed_host.h"
+#include "sensor_models.h"
+#include <chrono>
+
+using namespace mbed_host;
+
+/*********** firmware entry points *****************/
+void mbed_app_main();
+void CheckSpeed();
+void decode();
+void CheckTaps();
+void DispatchEvents();
+void flexed();
+void unflexed();
+void QueueMotion(const int16_t *acc, int n, const int16_t *gyr, int m);
+void FuseMotion();
+
+namespace {
+
+const uint64_t SEC = 1000000;
+const uint64_t MS = 1000;
+
+/** Wrist rolling back and forth at 0.5 Hz between 1 s and 7 s */
+void wrist_accel(uint64_t t, float g[3]) {
+    float s = t / 1e6f;
+    float a = (s > 1.0f && s < 7.0f) ? 0.9f * sinf(2.0f * 3.14159265f * 0.5f * s) : 0.0f;
+    g[0] = a;
+    g[1] = 0.05f;
+    g[2] = sqrtf(1.0f - a * a > 0.0f ? 1.0f - a * a : 0.0f);
+}
+
+/** Die warming 1 C per second from room temperature */
+float die_temp(uint64_t t) {
+    return 25.0f + t / 1e6f;
+}
+
+void wrist_rate(uint64_t t, float dps[3]) {
+    float s = t / 1e6f;
+    float w = (s > 1.0f && s < 7.0f) ? 160.0f * cosf(2.0f * 3.14159265f * 0.5f * s) : 0.0f;
+    dps[0] = w + 1.5f + 0.05f * (die_temp(t) - 25.0f); // zero-rate offset, drifts with temperature
+    dps[1] = -0.8f;
+    dps[2] = 0.4f;
+}
+
+// a pinch: the pressure sensor's digital pin and its analog level
+void press_at(uint64_t t_us, PinName pin, PinName level, float pressed,
+              float released, uint64_t len_us) {
+    pulse_pin_at(t_us, pin, len_us);
+    set_analog_at(t_us, level, pressed);
+    set_analog_at(t_us + len_us, level, released);
+}
+
+void session() {
+    board_lsm303().set_accel(wrist_accel);
+    board_l3gd20().set_rate(wrist_rate);
+    board_l3gd20().set_temperature(die_temp);
+    set_analog(A0, 0.60f);  // battery good
+    set_analog_at(0, A1, 0.10f);
+    set_analog_at(0, A2, 0.12f);
+
+    serial_rx_at(500 * MS, p13, 0);         // hub: play game
+    press_at(2000 * MS, p21, A1, 0.35f, 0.10f, 80 * MS);   // right double tap, medium
+    press_at(2250 * MS, p21, A1, 0.35f, 0.10f, 80 * MS);
+    press_at(3000 * MS, p22, A2, 0.22f, 0.12f, 80 * MS);   // left pinch, light
+    press_at(3400 * MS, p22, A2, 0.65f, 0.12f, 1200 * MS); // left pinch held, hard
+    set_pin_at(4000 * MS, p24, 1);          // fist
+    set_pin_at(4100 * MS, p24, 0);          // bounce
+    set_pin_at(4120 * MS, p24, 1);
+    set_pin_at(5000 * MS, p24, 0);          // open hand
+    serial_rx_at(6000 * MS, p13, 1);        // hub: collision
+    serial_rx_at(8000 * MS, p13, 4);        // hub: back to menu
+    serial_rx_at(8500 * MS, p13, 2);        // hub: plot mode
+    set_analog_at(9000 * MS, A1, 0.55f);
+    set_analog_at(9500 * MS, A2, 0.70f);
+    serial_rx_at(11000 * MS, p13, 4);       // hub: back to menu
+    serial_rx_at(11500 * MS, p13, 4);       // hub: quit
+}
+
+double wall_now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<typename F>
+void bench(const char *name, int n, F f) {
+    uint64_t v0 = now_us();
+    double w0 = wall_now();
+    for (int i = 0; i < n; i++) {
+        f();
+    }
+    double w = wall_now() - w0;
+    uint64_t v = now_us() - v0;
+    printf("[bench] %-12s %8d calls, %10.1f us virtual/call, %8.3f us host/call\r\n",
+           name, n, (double)v / n, w * 1e6 / n);
+}
+
+} // namespace
+
+int main() {
+    set_time_limit(120 * SEC);
+    session();
+    mbed_app_main();
+
+    const std::vector<TxByte> &tx = serial_tx_log(p13);
+    printf("\r\n[host] firmware returned at %.3f s, %u bytes sent to the hub\r\n",
+           now_us() / 1e6, (unsigned)tx.size());
+    report();
+
+    set_time_limit(UINT64_MAX);
+    bench("CheckSpeed", 1000, CheckSpeed);
+    bench("decode", 1000000, decode);
+    bench("CheckTaps", 100000, CheckTaps);
+    bench("flex cycle", 10000, []() { flexed(); wait_us(100); flexed(); unflexed(); DispatchEvents(); });
+
+    // one 100 ms FIFO drain: 1 accelerometer and 19 gyro samples
+    int16_t acc[3] = { 2458, 410, 7782 };      // 0.3, 0.05, 0.95 g
+    int16_t gyr[19 * 3];
+    for (int i = 0; i < 19 * 3; i++) {
+        gyr[i] = (int16_t)(4571.0f * sinf(i * 0.1f));  // +-40 dps
+    }
+    bench("FuseMotion", 100000, [&]() { QueueMotion(acc, 1, gyr, 19); FuseMotion(); });
+    return 0;
+}
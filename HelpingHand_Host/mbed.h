@@ -0,0 +1,257 @@
+/**
+* Host stand-in for the subset of the mbed 2 (LPC1768) API used by the
+* HelpingHand firmware, driven by a deterministic virtual clock.
+*
+* Nothing here touches real hardware: every peripheral is a view onto the
+* simulated board in mbed_host.cpp, and time only moves when the firmware
+* waits, polls, or performs a bus/UART transfer. Build a host binary with
+*
+*   g++ -std=c++11 -O2 -funsigned-char -IHelpingHand_Host -IHelpingHand_Menu
+*       -IHelpingHand_Menu/L3GD20_KenjiArai -IHelpingHand_Menu/LSM303DLHC_BC
+*       -IHelpingHand_Menu/I2CBus -IHelpingHand_Menu/HubFrame -IHelpingHand_Menu/HubInbox
+*       -IHelpingHand_Menu/Orientation -IHelpingHand_Menu/RotationSpeed -IHelpingHand_Menu/SensorCal
+*       -IHelpingHand_Menu/Quantizer -IHelpingHand_Menu/TapGesture -IHelpingHand_Menu/PinchForce
+*       -IHelpingHand_Menu/EventFifo
+*       -IHelpingHand_Menu/TimerWheel -IHelpingHand_Menu/Scheduler -IHelpingHand_Menu/AdcScan
+*       HelpingHand_Menu/main.cpp HelpingHand_Menu/L3GD20_KenjiArai/L3GD20_YY.cpp
+*       HelpingHand_Menu/LSM303DLHC_BC/LSM303DLHC.cpp HelpingHand_Menu/I2CBus/I2CBus.cpp
+*       HelpingHand_Menu/HubFrame/HubFrame.cpp HelpingHand_Menu/HubInbox/HubInbox.cpp
+*       HelpingHand_Menu/Orientation/Orientation.cpp HelpingHand_Menu/RotationSpeed/RotationSpeed.cpp
+*       HelpingHand_Menu/SensorCal/SensorCal.cpp
+*       HelpingHand_Menu/TapGesture/TapGesture.cpp HelpingHand_Menu/PinchForce/PinchForce.cpp
+*       HelpingHand_Menu/EventFifo/EventFifo.cpp
+*       HelpingHand_Menu/TimerWheel/TimerWheel.cpp HelpingHand_Menu/Scheduler/Scheduler.cpp
+*       HelpingHand_Menu/AdcScan/AdcScan.cpp
+*       HelpingHand_Host/host_main.cpp
+*       HelpingHand_Host/mbed_host.cpp HelpingHand_Host/sensor_models.cpp
+*       -o helping_hand_host
+*
+* (HelpingHand_Menu_Right in place of HelpingHand_Menu for the right hand).
+* -funsigned-char matches the ARM ABI the drivers were written against.
+*
+* The firmware main() is renamed to mbed_app_main() so host_main.cpp can
+* script the board around it. It becomes a void function because the
+* firmware relies on main() being allowed to fall off its end.
+*/
+#ifndef MBED_HOST_MBED_H
+#define MBED_HOST_MBED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <functional>
+
+#ifndef MBED_HOST_KEEP_MAIN
+#define main() mbed_app_main_decl(); void mbed_app_main()
+#endif
+
+/** LPC1768 DIP pin names, plus the aliases the firmware uses */
+typedef enum {
+    p5 = 5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16, p17, p18,
+    p19, p20, p21, p22, p23, p24, p25, p26, p27, p28, p29, p30,
+    LED1 = 101, LED2, LED3, LED4,
+    USBTX = 111, USBRX,
+    A0 = p15, A1 = p16, A2 = p17, A3 = p18, A4 = p19, A5 = p20,
+    NC = -1
+} PinName;
+
+void __disable_irq(void);
+void __enable_irq(void);
+void __WFI(void);
+
+void wait(float s);
+void wait_ms(int ms);
+void wait_us(int us);
+uint32_t us_ticker_read(void);
+
+/** Callback holder, the host equivalent of mbed's FunctionPointer */
+class FunctionPointer {
+public:
+    FunctionPointer() {}
+    FunctionPointer(void (*fptr)(void)) { attach(fptr); }
+    template<typename T>
+    FunctionPointer(T *object, void (T::*member)(void)) { attach(object, member); }
+
+    void attach(void (*fptr)(void)) {
+        if (fptr) _fn = fptr; else _fn = nullptr;
+    }
+    template<typename T>
+    void attach(T *object, void (T::*member)(void)) {
+        _fn = [object, member]() { (object->*member)(); };
+    }
+    void call() { if (_fn) _fn(); }
+    operator bool() const { return (bool)_fn; }
+
+private:
+    std::function<void()> _fn;
+};
+
+class DigitalOut {
+public:
+    DigitalOut(PinName pin);
+    void write(int value);
+    int read();
+    DigitalOut& operator= (int value) { write(value); return *this; }
+    operator int() { return read(); }
+
+private:
+    PinName _pin;
+};
+
+class DigitalIn {
+public:
+    DigitalIn(PinName pin);
+    int read();
+    operator int() { return read(); }
+
+private:
+    PinName _pin;
+};
+
+class PwmOut {
+public:
+    PwmOut(PinName pin);
+    void write(float value);
+    float read();
+    void period(float seconds);
+    void period_ms(int ms);
+    void period_us(int us);
+    PwmOut& operator= (float value) { write(value); return *this; }
+    operator float() { return read(); }
+
+private:
+    PinName _pin;
+};
+
+class AnalogIn {
+public:
+    AnalogIn(PinName pin);
+    float read();
+    unsigned short read_u16();
+    operator float() { return read(); }
+
+private:
+    PinName _pin;
+};
+
+class InterruptIn {
+public:
+    InterruptIn(PinName pin);
+    ~InterruptIn();
+    int read();
+    operator int() { return read(); }
+    void rise(void (*fptr)(void)) { _rise.attach(fptr); }
+    template<typename T>
+    void rise(T *object, void (T::*member)(void)) { _rise.attach(object, member); }
+    void fall(void (*fptr)(void)) { _fall.attach(fptr); }
+    template<typename T>
+    void fall(T *object, void (T::*member)(void)) { _fall.attach(object, member); }
+    void mode(int pull) { (void)pull; }
+    void enable_irq() { _enabled = true; }
+    void disable_irq() { _enabled = false; }
+
+    /** Called by the simulated board when the pin level changes */
+    void edge(int level);
+
+private:
+    PinName _pin;
+    bool _enabled;
+    FunctionPointer _rise;
+    FunctionPointer _fall;
+};
+
+class Timer {
+public:
+    Timer();
+    void start();
+    void stop();
+    void reset();
+    float read();
+    int read_ms();
+    int read_us();
+    operator float() { return read(); }
+
+private:
+    uint64_t elapsed_us();
+    int _running;
+    uint64_t _start;
+    uint64_t _time;
+};
+
+class Ticker {
+public:
+    Ticker();
+    virtual ~Ticker();
+    void attach(void (*fptr)(void), float t) { attach_us(fptr, (uint64_t)(t * 1000000.0f)); }
+    template<typename T>
+    void attach(T *object, void (T::*member)(void), float t) {
+        attach_us(object, member, (uint64_t)(t * 1000000.0f));
+    }
+    void attach_us(void (*fptr)(void), uint64_t t) { _function.attach(fptr); setup(t); }
+    template<typename T>
+    void attach_us(T *object, void (T::*member)(void), uint64_t t) {
+        _function.attach(object, member);
+        setup(t);
+    }
+    void detach();
+
+protected:
+    void setup(uint64_t t);
+    virtual void handler();
+
+    uint64_t _delay;
+    int _event;
+    FunctionPointer _function;
+};
+
+class Timeout : public Ticker {
+protected:
+    virtual void handler();
+};
+
+class Serial {
+public:
+    enum IrqType { RxIrq = 0, TxIrq };
+
+    Serial(PinName tx, PinName rx, const char *name = NULL);
+    void baud(int baudrate);
+    int putc(int c);
+    int getc();
+    int puts(const char *str);
+    int printf(const char *format, ...);
+    int readable();
+    int writeable();
+    void attach(void (*fptr)(void), IrqType type = RxIrq) { _irq[type].attach(fptr); }
+    template<typename T>
+    void attach(T *object, void (T::*member)(void), IrqType type = RxIrq) {
+        _irq[type].attach(object, member);
+    }
+
+    /** Called by the simulated board when an interrupt condition occurs */
+    void irq(IrqType type) { _irq[type].call(); }
+    bool attached(IrqType type) const { return (bool)_irq[type]; }
+
+private:
+    PinName _tx;
+    FunctionPointer _irq[2];
+};
+
+class I2C {
+public:
+    enum RxStatus { NoData, MasterGeneralCall, MasterWrite, MasterRead };
+    enum Acknowledge { NoACK = 0, ACK = 1 };
+
+    I2C(PinName sda, PinName scl);
+    void frequency(int hz);
+    int read(int address, char *data, int length, bool repeated = false);
+    int write(int address, const char *data, int length, bool repeated = false);
+
+private:
+    PinName _sda;
+    int _hz;
+};
+
+#endif
@@ -0,0 +1,542 @@
+/**
+* Virtual clock, event queue and peripheral stand-ins for the host build.
+*
+* Simulated interrupts are events on a single time-ordered queue. They are
+* dispatched whenever the firmware lets virtual time pass (wait, polling,
+* bus and UART transfers), never nest, and are held off while the firmware
+* has interrupts masked with __disable_irq().
+*/
+#include "mbed_host.h"
+#include "sensor_models.h"
+#include <map>
+#include <deque>
+#include <chrono>
+
+namespace mbed_host {
+
+namespace {
+
+const int UART_FIFO_DEPTH = 16;
+const uint64_t POLL_COST_US = 1;        // one register poll on the APB bus
+const uint64_t ADC_CONVERSION_US = 15;  // mbed's 3-sample median at 13 MHz
+
+struct Pin {
+    Pin() : level(0), analog(0.0f), output(0.0f) {}
+    int level;
+    float analog;
+    float output;
+    std::vector<InterruptIn*> irqs;
+};
+
+struct Uart {
+    Uart() : baud(9600), tx_done(0), thre_event(-1), echo(false), owner(NULL), rx_overruns(0) {}
+    int baud;
+    uint64_t tx_done;   // when the last queued byte has left the shift register
+    int thre_event;     // pending TX FIFO empty interrupt
+    bool echo;
+    Serial *owner;
+    std::deque<uint8_t> rx;
+    std::vector<TxByte> tx;
+    uint64_t rx_overruns;
+};
+
+struct Bus {
+    std::map<int, I2CDevice*> devices;
+};
+
+struct Sim {
+    Sim() : now(0), next_id(1), irq_mask(0), isr(false), limit(UINT64_MAX),
+            wall_start(std::chrono::steady_clock::now()) {
+        memset(&stats, 0, sizeof(stats));
+    }
+    uint64_t now;
+    int next_id;
+    int irq_mask;
+    bool isr;
+    uint64_t limit;
+    std::map<std::pair<uint64_t, int>, Event> events;
+    std::map<int, uint64_t> event_times;
+    std::map<int, Pin> pins;
+    std::map<int, Uart> uarts;
+    std::map<int, Bus> buses;
+    Stats stats;
+    std::chrono::steady_clock::time_point wall_start;
+};
+
+Sim& sim() {
+    static Sim s;
+    return s;
+}
+
+void finish() {
+    report();
+    fflush(stdout);
+    exit(0);
+}
+
+void check_limit() {
+    if (sim().now >= sim().limit) {
+        finish();
+    }
+}
+
+void dispatch(uint64_t until) {
+    Sim &s = sim();
+    while (s.irq_mask == 0 && !s.isr && !s.events.empty()) {
+        std::map<std::pair<uint64_t, int>, Event>::iterator it = s.events.begin();
+        if (it->first.first > until) {
+            break;
+        }
+        if (it->first.first > s.now) {
+            s.now = it->first.first;
+        }
+        Event ev = it->second;
+        s.event_times.erase(it->first.second);
+        s.events.erase(it);
+        s.isr = true;
+        s.stats.isr_calls++;
+        ev();
+        s.isr = false;
+    }
+}
+
+/** Block until the next event fires, as a core spinning on a flag would */
+void idle_until_event(uint64_t *counter) {
+    Sim &s = sim();
+    uint64_t t = next_event_us();
+    if (t == UINT64_MAX) {
+        if (s.limit == UINT64_MAX) {
+            fprintf(stderr, "[host] firmware is waiting for an event that can never come\r\n");
+            finish();
+        }
+        t = s.limit;
+    }
+    uint64_t d = t > s.now ? t - s.now : 0;
+    if (counter) {
+        *counter += d;
+    }
+    advance_us(d);
+}
+
+void deliver_edge(PinName pin, int level) {
+    std::vector<InterruptIn*> irqs = sim().pins[pin].irqs;
+    for (size_t i = 0; i < irqs.size(); i++) {
+        irqs[i]->edge(level);
+    }
+}
+
+void apply_pin(PinName pin, int level) {
+    Pin &p = sim().pins[pin];
+    if (p.level == level) {
+        return;
+    }
+    p.level = level;
+    deliver_edge(pin, level);
+}
+
+Bus& bus(PinName sda) {
+    Sim &s = sim();
+    bool fresh = s.buses.find(sda) == s.buses.end();
+    Bus &b = s.buses[sda];
+    if (fresh) {
+        attach_board_sensors(sda);
+    }
+    return b;
+}
+
+uint64_t i2c_cost_us(int bytes, int hz) {
+    // address + data bytes at 9 clocks each, plus start and stop
+    return ((uint64_t)(1 + bytes) * 9 + 2) * 1000000 / (uint64_t)hz;
+}
+
+} // namespace
+
+uint64_t now_us() { return sim().now; }
+
+void advance_us(uint64_t us) {
+    Sim &s = sim();
+    uint64_t target = s.now + us;
+    dispatch(target);
+    if (s.now < target) {
+        s.now = target;
+    }
+    check_limit();
+}
+
+int schedule_at(uint64_t t_us, Event ev) {
+    Sim &s = sim();
+    int id = s.next_id++;
+    s.events[std::make_pair(t_us, id)] = ev;
+    s.event_times[id] = t_us;
+    return id;
+}
+
+void cancel(int id) {
+    Sim &s = sim();
+    std::map<int, uint64_t>::iterator it = s.event_times.find(id);
+    if (it == s.event_times.end()) {
+        return;
+    }
+    s.events.erase(std::make_pair(it->second, id));
+    s.event_times.erase(it);
+}
+
+uint64_t next_event_us() {
+    Sim &s = sim();
+    return s.events.empty() ? UINT64_MAX : s.events.begin()->first.first;
+}
+
+void set_time_limit(uint64_t t_us) { sim().limit = t_us; }
+
+bool in_isr() { return sim().isr; }
+
+void set_pin(PinName pin, int level) {
+    // the level is visible at once, the edge interrupt is taken when the
+    // running code next lets events through
+    Pin &p = sim().pins[pin];
+    if (p.level == level) {
+        return;
+    }
+    p.level = level;
+    schedule_at(sim().now, [pin, level]() { deliver_edge(pin, level); });
+}
+
+int get_pin(PinName pin) { return sim().pins[pin].level; }
+
+void set_pin_at(uint64_t t_us, PinName pin, int level) {
+    schedule_at(t_us, [pin, level]() { apply_pin(pin, level); });
+}
+
+void pulse_pin_at(uint64_t t_us, PinName pin, uint64_t hold_us) {
+    set_pin_at(t_us, pin, 1);
+    set_pin_at(t_us + hold_us, pin, 0);
+}
+
+void set_analog(PinName pin, float value) { sim().pins[pin].analog = value; }
+
+void set_analog_at(uint64_t t_us, PinName pin, float value) {
+    schedule_at(t_us, [pin, value]() { sim().pins[pin].analog = value; });
+}
+
+float get_output(PinName pin) { return sim().pins[pin].output; }
+
+void serial_rx_at(uint64_t t_us, PinName tx, uint8_t byte) {
+    schedule_at(t_us, [tx, byte]() {
+        Uart &u = sim().uarts[tx];
+        if ((int)u.rx.size() >= UART_FIFO_DEPTH) {
+            u.rx_overruns++;
+            return;
+        }
+        u.rx.push_back(byte);
+        if (u.owner) {
+            u.owner->irq(Serial::RxIrq);
+        }
+    });
+}
+
+const std::vector<TxByte>& serial_tx_log(PinName tx) { return sim().uarts[tx].tx; }
+
+void serial_echo(PinName tx, bool on) { sim().uarts[tx].echo = on; }
+
+void i2c_attach(PinName sda, int address, I2CDevice *dev) {
+    bus(sda).devices[address & ~1] = dev;
+}
+
+Stats& stats() { return sim().stats; }
+
+void report() {
+    static bool done = false;
+    if (done) {
+        return;
+    }
+    done = true;
+    Sim &s = sim();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - s.wall_start).count();
+    double virt = s.now / 1e6;
+    printf("\r\n[host] virtual time %.3f s, wall time %.3f s (x%.0f)\r\n",
+           virt, wall, wall > 0 ? virt / wall : 0.0);
+    printf("[host] i2c: %llu transfers, %llu bytes, %.1f ms busy\r\n",
+           (unsigned long long)s.stats.i2c_transfers, (unsigned long long)s.stats.i2c_bytes,
+           s.stats.i2c_busy_us / 1e3);
+    printf("[host] uart: %llu bytes sent, %.1f ms blocked in putc\r\n",
+           (unsigned long long)s.stats.uart_tx_bytes, s.stats.uart_blocked_us / 1e3);
+    printf("[host] cpu: %.1f ms in wait, %.1f ms asleep, %llu isr calls\r\n",
+           s.stats.wait_us / 1e3, s.stats.sleep_us / 1e3, (unsigned long long)s.stats.isr_calls);
+    for (std::map<int, Uart>::iterator it = s.uarts.begin(); it != s.uarts.end(); ++it) {
+        if (it->second.rx_overruns) {
+            printf("[host] uart tx=p%d dropped %llu rx bytes\r\n",
+                   it->first, (unsigned long long)it->second.rx_overruns);
+        }
+    }
+}
+
+} // namespace mbed_host
+
+using namespace mbed_host;
+
+/*********** core *****************/
+void __disable_irq(void) { sim().irq_mask++; }
+
+void __enable_irq(void) {
+    Sim &s = sim();
+    if (s.irq_mask > 0 && --s.irq_mask == 0) {
+        dispatch(s.now);
+    }
+}
+
+void __WFI(void) { idle_until_event(&sim().stats.sleep_us); }
+
+void wait(float s) { wait_us((int)(s * 1000000.0f)); }
+
+void wait_ms(int ms) { wait_us(ms * 1000); }
+
+void wait_us(int us) {
+    sim().stats.wait_us += us;
+    advance_us(us);
+}
+
+uint32_t us_ticker_read(void) { return (uint32_t)sim().now; }
+
+/*********** gpio *****************/
+DigitalOut::DigitalOut(PinName pin) : _pin(pin) {}
+
+void DigitalOut::write(int value) {
+    sim().pins[_pin].output = value ? 1.0f : 0.0f;
+}
+
+int DigitalOut::read() { return sim().pins[_pin].output != 0.0f; }
+
+DigitalIn::DigitalIn(PinName pin) : _pin(pin) {}
+
+int DigitalIn::read() { return sim().pins[_pin].level; }
+
+PwmOut::PwmOut(PinName pin) : _pin(pin) {}
+
+void PwmOut::write(float value) {
+    if (value < 0.0f) value = 0.0f;
+    if (value > 1.0f) value = 1.0f;
+    sim().pins[_pin].output = value;
+}
+
+float PwmOut::read() { return sim().pins[_pin].output; }
+void PwmOut::period(float seconds) { (void)seconds; }
+void PwmOut::period_ms(int ms) { (void)ms; }
+void PwmOut::period_us(int us) { (void)us; }
+
+AnalogIn::AnalogIn(PinName pin) : _pin(pin) {}
+
+float AnalogIn::read() {
+    advance_us(ADC_CONVERSION_US);
+    return sim().pins[_pin].analog;
+}
+
+unsigned short AnalogIn::read_u16() {
+    float v = read();
+    return (unsigned short)(v * 65535.0f);
+}
+
+InterruptIn::InterruptIn(PinName pin) : _pin(pin), _enabled(true) {
+    sim().pins[_pin].irqs.push_back(this);
+}
+
+InterruptIn::~InterruptIn() {
+    std::vector<InterruptIn*> &irqs = sim().pins[_pin].irqs;
+    for (size_t i = 0; i < irqs.size(); i++) {
+        if (irqs[i] == this) {
+            irqs.erase(irqs.begin() + i);
+            break;
+        }
+    }
+}
+
+int InterruptIn::read() { return sim().pins[_pin].level; }
+
+void InterruptIn::edge(int level) {
+    if (!_enabled) {
+        return;
+    }
+    if (level) {
+        _rise.call();
+    } else {
+        _fall.call();
+    }
+}
+
+/*********** timers *****************/
+Timer::Timer() : _running(0), _start(0), _time(0) {}
+
+void Timer::start() {
+    if (!_running) {
+        _start = sim().now;
+        _running = 1;
+    }
+}
+
+void Timer::stop() {
+    _time += elapsed_us();
+    _running = 0;
+}
+
+void Timer::reset() {
+    _start = sim().now;
+    _time = 0;
+}
+
+uint64_t Timer::elapsed_us() {
+    return _running ? sim().now - _start : 0;
+}
+
+float Timer::read() { return (_time + elapsed_us()) / 1000000.0f; }
+int Timer::read_ms() { return (int)((_time + elapsed_us()) / 1000); }
+int Timer::read_us() { return (int)(_time + elapsed_us()); }
+
+Ticker::Ticker() : _delay(0), _event(-1) {}
+
+Ticker::~Ticker() { detach(); }
+
+void Ticker::setup(uint64_t t) {
+    cancel(_event);
+    _delay = t ? t : 1;
+    _event = schedule_at(sim().now + _delay, [this]() { handler(); });
+}
+
+void Ticker::detach() {
+    cancel(_event);
+    _event = -1;
+}
+
+void Ticker::handler() {
+    _event = schedule_at(sim().now + _delay, [this]() { handler(); });
+    _function.call();
+}
+
+void Timeout::handler() {
+    _event = -1;
+    _function.call();
+}
+
+/*********** uart *****************/
+Serial::Serial(PinName tx, PinName rx, const char *name) : _tx(tx) {
+    (void)rx;
+    (void)name;
+    Uart &u = sim().uarts[_tx];
+    u.owner = this;
+    if (tx == USBTX) {
+        u.echo = true;
+    }
+}
+
+void Serial::baud(int baudrate) { sim().uarts[_tx].baud = baudrate; }
+
+int Serial::putc(int c) {
+    Sim &s = sim();
+    Uart &u = s.uarts[_tx];
+    uint64_t byte_us = 10000000ULL / (uint64_t)u.baud;
+    // the FIFO holds UART_FIFO_DEPTH bytes behind the one being shifted out
+    if (u.tx_done > s.now + UART_FIFO_DEPTH * byte_us) {
+        uint64_t d = u.tx_done - s.now - UART_FIFO_DEPTH * byte_us;
+        s.stats.uart_blocked_us += d;
+        advance_us(d);
+    }
+    advance_us(POLL_COST_US);
+    Uart &v = s.uarts[_tx];
+    v.tx_done = (v.tx_done > s.now ? v.tx_done : s.now) + byte_us;
+    TxByte b = { v.tx_done, (uint8_t)c };
+    v.tx.push_back(b);
+    if (v.owner && v.owner->attached(Serial::TxIrq)) {
+        // THRE: the FIFO is empty once the last byte moves to the shift register
+        PinName tx = _tx;
+        cancel(v.thre_event);
+        v.thre_event = schedule_at(v.tx_done - byte_us, [tx]() {
+            Uart &u = sim().uarts[tx];
+            u.thre_event = -1;
+            u.owner->irq(Serial::TxIrq);
+        });
+    }
+    s.stats.uart_tx_bytes++;
+    if (v.echo) {
+        fputc(c, stdout);
+    }
+    return c;
+}
+
+int Serial::getc() {
+    while (sim().uarts[_tx].rx.empty()) {
+        idle_until_event(NULL);
+    }
+    Uart &u = sim().uarts[_tx];
+    int c = u.rx.front();
+    u.rx.pop_front();
+    return c;
+}
+
+int Serial::puts(const char *str) {
+    int n = 0;
+    while (*str) {
+        putc(*str++);
+        n++;
+    }
+    return n;
+}
+
+int Serial::printf(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    puts(buf);
+    return n;
+}
+
+int Serial::readable() {
+    advance_us(POLL_COST_US);
+    return !sim().uarts[_tx].rx.empty();
+}
+
+int Serial::writeable() {
+    advance_us(POLL_COST_US);
+    Sim &s = sim();
+    Uart &u = s.uarts[_tx];
+    uint64_t byte_us = 10000000ULL / (uint64_t)u.baud;
+    return u.tx_done <= s.now + UART_FIFO_DEPTH * byte_us;
+}
+
+/*********** i2c *****************/
+I2C::I2C(PinName sda, PinName scl) : _sda(sda), _hz(100000) {
+    (void)scl;
+}
+
+void I2C::frequency(int hz) { _hz = hz; }
+
+int I2C::write(int address, const char *data, int length, bool repeated) {
+    (void)repeated;
+    Sim &s = sim();
+    uint64_t d = i2c_cost_us(length, _hz);
+    s.stats.i2c_transfers++;
+    s.stats.i2c_bytes += length;
+    s.stats.i2c_busy_us += d;
+    advance_us(d);
+    Bus &b = bus(_sda);
+    std::map<int, I2CDevice*>::iterator it = b.devices.find(address & ~1);
+    if (it == b.devices.end()) {
+        return 1;   // address NACK
+    }
+    return it->second->write(data, length) ? 0 : 1;
+}
+
+int I2C::read(int address, char *data, int length, bool repeated) {
+    (void)repeated;
+    Sim &s = sim();
+    uint64_t d = i2c_cost_us(length, _hz);
+    s.stats.i2c_transfers++;
+    s.stats.i2c_bytes += length;
+    s.stats.i2c_busy_us += d;
+    advance_us(d);
+    Bus &b = bus(_sda);
+    std::map<int, I2CDevice*>::iterator it = b.devices.find(address & ~1);
+    if (it == b.devices.end()) {
+        return 1;
+    }
+    return it->second->read(data, length) ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+/**
+* Control side of the host board simulation.
+*
+* The firmware only sees mbed.h; scenario code (host_main.cpp) uses this
+* header to script pin levels, analog voltages, hub bytes and sensor motion
+* against the virtual clock, and to read back what the firmware did.
+*/
+#ifndef MBED_HOST_H
+#define MBED_HOST_H
+
+#include "mbed.h"
+#include <vector>
+
+class InterruptIn;
+class Serial;
+
+namespace mbed_host {
+
+typedef std::function<void()> Event;
+
+/** Virtual time since reset in microseconds */
+uint64_t now_us();
+
+/** Let virtual time pass, dispatching every event that falls due */
+void advance_us(uint64_t us);
+
+/** Schedule a one-shot event at an absolute virtual time, returns its id */
+int schedule_at(uint64_t t_us, Event ev);
+
+/** Cancel a pending event, ignores unknown ids */
+void cancel(int id);
+
+/** Time of the next pending event, or UINT64_MAX if there is none */
+uint64_t next_event_us();
+
+/** End the run (report and exit) once virtual time passes t_us */
+void set_time_limit(uint64_t t_us);
+
+/** True while an event handler (simulated ISR) is running */
+bool in_isr();
+
+/** Pin level, drives InterruptIn edges at the current virtual time */
+void set_pin(PinName pin, int level);
+int get_pin(PinName pin);
+
+/** Pin level at a future virtual time */
+void set_pin_at(uint64_t t_us, PinName pin, int level);
+
+/** Rising edge followed by a falling edge hold_us later */
+void pulse_pin_at(uint64_t t_us, PinName pin, uint64_t hold_us);
+
+/** Normalised analog level (0.0 - 1.0) seen by AnalogIn */
+void set_analog(PinName pin, float value);
+void set_analog_at(uint64_t t_us, PinName pin, float value);
+
+/** PWM / digital output level last written by the firmware */
+float get_output(PinName pin);
+
+/** Queue a byte for the UART whose TX pin is tx, arriving at t_us */
+void serial_rx_at(uint64_t t_us, PinName tx, uint8_t byte);
+
+/** One byte transmitted by the firmware */
+struct TxByte {
+    uint64_t t_us;
+    uint8_t byte;
+};
+
+/** Everything the UART whose TX pin is tx has sent so far */
+const std::vector<TxByte>& serial_tx_log(PinName tx);
+
+/** Echo bytes sent on this UART to stdout (USBTX does by default) */
+void serial_echo(PinName tx, bool on);
+
+/** Register-level model of one I2C slave */
+class I2CDevice {
+public:
+    virtual ~I2CDevice() {}
+    /** Master wrote bytes (first one is normally the register address) */
+    virtual bool write(const char *data, int length) = 0;
+    /** Master reads bytes from the current register pointer */
+    virtual bool read(char *data, int length) = 0;
+};
+
+/** Attach a model to the bus whose SDA pin is sda at an 8-bit address */
+void i2c_attach(PinName sda, int address, I2CDevice *dev);
+
+/** Counters for profiling the firmware against the virtual clock */
+struct Stats {
+    uint64_t i2c_transfers;     // address phases on any bus
+    uint64_t i2c_bytes;         // data bytes moved on any bus
+    uint64_t i2c_busy_us;       // virtual time the firmware spent on the bus
+    uint64_t uart_tx_bytes;
+    uint64_t uart_blocked_us;   // virtual time spent waiting for a TX slot
+    uint64_t wait_us;           // virtual time spent in wait()/wait_ms()/wait_us()
+    uint64_t sleep_us;          // virtual time spent in __WFI()
+    uint64_t isr_calls;
+};
+
+Stats& stats();
+
+/** Print the run summary, also done automatically at exit */
+void report();
+
+} // namespace mbed_host
+
+#endif
@@ -0,0 +1,408 @@
+/**
+* LSM303DLHC and L3GD20 register models, see sensor_models.h
+*/
+#include "sensor_models.h"
+
+namespace mbed_host {
+
+namespace {
+
+const int ACC_ADDR  = 0x32;
+const int MAG_ADDR  = 0x3c;
+const int GYRO_ADDR = 0x6b << 1;
+
+// ODR periods indexed by CTRL_REG1_A[7:4], 0 = power down
+const uint64_t acc_period_us[16] = {
+    0, 1000000, 100000, 40000, 20000, 10000, 5000, 2500,
+    617, 744, 0, 0, 0, 0, 0, 0
+};
+
+// left justified counts per g indexed by CTRL_REG4_A[5:4] (12 mg/LSB at 16 g)
+const float acc_counts_per_g[4] = { 16384.0f, 8192.0f, 4096.0f, 1333.0f };
+
+// ODR periods indexed by CTRL_REG1[7:6] (L3GD20 95/190/380/760 Hz)
+const uint64_t gyro_period_us[4] = { 10526, 5263, 2632, 1316 };
+
+// mdps per LSB indexed by CTRL_REG4[5:4]
+const float gyro_mdps[4] = { 8.75f, 17.5f, 70.0f, 70.0f };
+
+int16_t clamp16(float v) {
+    if (v > 32767.0f) return 32767;
+    if (v < -32768.0f) return -32768;
+    return (int16_t)lrintf(v);
+}
+
+void still_accel(uint64_t t, float v[3]) { (void)t; v[0] = 0.0f; v[1] = 0.0f; v[2] = 1.0f; }
+void still_mag(uint64_t t, float v[3])   { (void)t; v[0] = 0.3f; v[1] = 0.0f; v[2] = -0.4f; }
+void still_rate(uint64_t t, float v[3])  { (void)t; v[0] = 0.0f; v[1] = 0.0f; v[2] = 0.0f; }
+float room_temp(uint64_t t)              { (void)t; return 25.0f; }
+
+} // namespace
+
+/*********** LSM303DLHC accelerometer *****************/
+LSM303DLHCModel::Accel::Accel(LSM303DLHCModel *m)
+    : model(m), ptr(0), inc(false), next_sample(0), samples(0),
+      fifo_head(0), fifo_level(0) {
+    memset(regs, 0, sizeof(regs));
+    regs[0x20] = 0x07;  // CTRL_REG1_A reset value: power down, XYZ enabled
+}
+
+uint64_t LSM303DLHCModel::Accel::period_us() {
+    uint8_t odr = regs[0x20] >> 4;
+    bool lp = regs[0x20] & 0x08;
+    if (odr == 9 && lp) {
+        return 186;     // 5.376 kHz in low-power mode
+    }
+    if (odr == 8 && !lp) {
+        return 0;
+    }
+    return acc_period_us[odr];
+}
+
+void LSM303DLHCModel::Accel::update() {
+    uint64_t period = period_us();
+    uint64_t now = now_us();
+    if (period == 0) {
+        next_sample = now;
+        return;
+    }
+    if (now > next_sample + 64 * period) {
+        // nothing older than a full FIFO can be observed
+        next_sample += ((now - next_sample) / period - 32) * period;
+    }
+    while (next_sample <= now) {
+        produce(next_sample);
+        next_sample += period;
+    }
+}
+
+void LSM303DLHCModel::Accel::produce(uint64_t t) {
+    float g[3];
+    model->_acc_src(t, g);
+    float counts_per_g = acc_counts_per_g[(regs[0x23] >> 4) & 0x03];
+    uint16_t mask = 0xffc0;                     // normal mode, 10 bit
+    if (regs[0x20] & 0x08) mask = 0xff00;       // low power, 8 bit
+    else if (regs[0x23] & 0x08) mask = 0xfff0;  // high resolution, 12 bit
+    for (int i = 0; i < 3; i++) {
+        uint16_t v = (uint16_t)clamp16(g[i] * counts_per_g) & mask;
+        regs[0x28 + 2 * i] = v & 0xff;
+        regs[0x29 + 2 * i] = v >> 8;
+    }
+    if (regs[0x27] & 0x08) {
+        regs[0x27] |= 0x80;     // ZYXOR: previous sample never read
+    }
+    regs[0x27] |= 0x0f;
+    samples++;
+    if (!fifo_active()) {
+        return;
+    }
+    if (fifo_level == 32) {
+        if ((regs[0x2e] >> 6) == 1) {
+            return;             // FIFO mode stops collecting once full
+        }
+        fifo_head = (fifo_head + 1) % 32;   // stream mode drops the oldest
+        fifo_level--;
+    }
+    memcpy(fifo[(fifo_head + fifo_level) % 32], &regs[0x28], 6);
+    fifo_level++;
+}
+
+bool LSM303DLHCModel::Accel::fifo_active() {
+    return (regs[0x24] & 0x40) && (regs[0x2e] >> 6) != 0;
+}
+
+uint8_t LSM303DLHCModel::Accel::fifo_src() {
+    uint8_t src = fifo_level > 31 ? 31 : fifo_level;
+    if (fifo_level > (regs[0x2e] & 0x1f)) src |= 0x80;  // WTM
+    if (fifo_level == 32) src |= 0x40;                  // OVRN_FIFO
+    if (fifo_level == 0) src |= 0x20;                   // EMPTY
+    return src;
+}
+
+bool LSM303DLHCModel::Accel::write(const char *data, int length) {
+    if (length < 1) {
+        return true;
+    }
+    ptr = data[0] & 0x7f;
+    inc = data[0] & 0x80;
+    for (int i = 1; i < length; i++) {
+        update();
+        regs[ptr & 0x3f] = data[i];
+        if (ptr == 0x20) {
+            next_sample = now_us() + period_us();
+        }
+        if (ptr == 0x2e && (data[i] >> 6) == 0) {
+            fifo_head = 0;      // bypass mode empties the FIFO
+            fifo_level = 0;
+        }
+        if (inc) ptr++;
+    }
+    return true;
+}
+
+bool LSM303DLHCModel::Accel::read(char *data, int length) {
+    update();
+    bool fifo_on = fifo_active();
+    for (int i = 0; i < length; i++) {
+        uint8_t r = ptr & 0x3f;
+        if (fifo_on && r >= 0x28 && r <= 0x2d && fifo_level > 0) {
+            data[i] = fifo[fifo_head][r - 0x28];
+        } else if (r == 0x2f) {
+            data[i] = fifo_src();
+        } else {
+            data[i] = regs[r];
+        }
+        if (r == 0x2d) {
+            regs[0x27] = 0;     // reading OUT_Z_H_A clears the status flags
+            if (fifo_on && fifo_level > 0) {
+                fifo_head = (fifo_head + 1) % 32;
+                fifo_level--;
+            }
+        }
+        if (inc) {
+            // with the FIFO enabled the address rolls back to OUT_X_L_A
+            ptr = (fifo_on && r == 0x2d) ? 0x28 : ptr + 1;
+        }
+    }
+    return true;
+}
+
+/*********** LSM303DLHC magnetometer *****************/
+LSM303DLHCModel::Mag::Mag(LSM303DLHCModel *m) : model(m), ptr(0) {
+    memset(regs, 0, sizeof(regs));
+    regs[0x00] = 0x10;
+    regs[0x01] = 0x20;
+    regs[0x02] = 0x03;  // sleep
+    regs[0x0a] = 'H';
+    regs[0x0b] = '4';
+    regs[0x0c] = '3';
+}
+
+void LSM303DLHCModel::Mag::produce() {
+    if ((regs[0x02] & 0x03) != 0) {
+        return;         // not in continuous-conversion mode
+    }
+    // gain for the +-1.3 gauss range, x/y and z differ on this part
+    float b[3];
+    model->_mag_src(now_us(), b);
+    int16_t x = clamp16(b[0] * 1100.0f);
+    int16_t y = clamp16(b[1] * 1100.0f);
+    int16_t z = clamp16(b[2] * 980.0f);
+    regs[0x03] = (uint16_t)x >> 8; regs[0x04] = x & 0xff;
+    regs[0x05] = (uint16_t)z >> 8; regs[0x06] = z & 0xff;
+    regs[0x07] = (uint16_t)y >> 8; regs[0x08] = y & 0xff;
+    regs[0x09] = 0x01;
+}
+
+bool LSM303DLHCModel::Mag::write(const char *data, int length) {
+    if (length < 1) {
+        return true;
+    }
+    ptr = data[0] & 0x7f;   // the magnetometer always auto-increments
+    for (int i = 1; i < length; i++) {
+        regs[ptr++ & 0x3f] = data[i];
+    }
+    return true;
+}
+
+bool LSM303DLHCModel::Mag::read(char *data, int length) {
+    if (ptr == 0x03) {
+        produce();
+    }
+    for (int i = 0; i < length; i++) {
+        data[i] = regs[ptr++ & 0x3f];
+    }
+    return true;
+}
+
+LSM303DLHCModel::LSM303DLHCModel()
+    : _acc_src(still_accel), _mag_src(still_mag), _acc(this), _mag(this) {}
+
+/*********** L3GD20 *****************/
+L3GD20Model::L3GD20Model()
+    : _rate_src(still_rate), _temp_src(room_temp), _ptr(0), _inc(false),
+      _next_sample(0), _samples(0), _fifo_head(0), _fifo_level(0),
+      _int2(NC), _int2_level(0), _int2_event(-1) {
+    memset(_regs, 0, sizeof(_regs));
+    _regs[0x0f] = 0xd4;     // WHO_AM_I
+    _regs[0x20] = 0x07;     // CTRL_REG1 reset value: power down, XYZ enabled
+}
+
+uint64_t L3GD20Model::period_us() {
+    if (!(_regs[0x20] & 0x08)) {
+        return 0;           // power down
+    }
+    return gyro_period_us[_regs[0x20] >> 6];
+}
+
+void L3GD20Model::update() {
+    uint64_t period = period_us();
+    uint64_t now = now_us();
+    if (period == 0) {
+        _next_sample = now;
+        return;
+    }
+    if (now > _next_sample + 64 * period) {
+        _next_sample += ((now - _next_sample) / period - 32) * period;
+    }
+    while (_next_sample <= now) {
+        produce(_next_sample);
+        _next_sample += period;
+    }
+}
+
+void L3GD20Model::produce(uint64_t t) {
+    float dps[3];
+    _rate_src(t, dps);
+    float lsb_per_dps = 1000.0f / gyro_mdps[(_regs[0x23] >> 4) & 0x03];
+    for (int i = 0; i < 3; i++) {
+        int16_t v = clamp16(dps[i] * lsb_per_dps);
+        _regs[0x28 + 2 * i] = (uint16_t)v & 0xff;
+        _regs[0x29 + 2 * i] = (uint16_t)v >> 8;
+    }
+    // OUT_TEMP is -1 LSB/degC, 0 at 25 degC
+    _regs[0x26] = (uint8_t)(int8_t)lrintf(25.0f - _temp_src(t));
+    if (_regs[0x27] & 0x08) {
+        _regs[0x27] |= 0x80;
+    }
+    _regs[0x27] |= 0x0f;
+    _samples++;
+    if (!fifo_active()) {
+        return;
+    }
+    if (_fifo_level == 32) {
+        if ((_regs[0x2e] >> 5) == 1) {
+            return;             // FIFO mode stops collecting once full
+        }
+        _fifo_head = (_fifo_head + 1) % 32;
+        _fifo_level--;
+    }
+    memcpy(_fifo[(_fifo_head + _fifo_level) % 32], &_regs[0x28], 6);
+    _fifo_level++;
+}
+
+bool L3GD20Model::fifo_active() {
+    return (_regs[0x24] & 0x40) && (_regs[0x2e] >> 5) != 0;
+}
+
+uint8_t L3GD20Model::fifo_src() {
+    uint8_t src = _fifo_level > 31 ? 31 : _fifo_level;
+    if (_fifo_level > (_regs[0x2e] & 0x1f)) src |= 0x80;   // WTM
+    if (_fifo_level == 32) src |= 0x40;                    // OVRN
+    if (_fifo_level == 0) src |= 0x20;                     // EMPTY
+    return src;
+}
+
+void L3GD20Model::update_int2() {
+    if (_int2 == NC) {
+        return;
+    }
+    uint8_t cfg = _regs[0x22];
+    uint8_t src = fifo_src();
+    bool active = ((cfg & 0x08) && (_regs[0x27] & 0x08))   // I2_DRDY
+               || ((cfg & 0x04) && (src & 0x80))           // I2_WTM
+               || ((cfg & 0x02) && (src & 0x40))           // I2_ORun
+               || ((cfg & 0x01) && (src & 0x20));          // I2_Empty
+    if (cfg & 0x20) {
+        active = !active;       // H_Lactive
+    }
+    if (_int2_level != (int)active) {
+        _int2_level = active;
+        set_pin(_int2, active);
+    }
+}
+
+void L3GD20Model::schedule_int2() {
+    cancel(_int2_event);
+    _int2_event = -1;
+    if (_int2 == NC || (_regs[0x22] & 0x0f) == 0 || period_us() == 0) {
+        return;
+    }
+    _int2_event = schedule_at(_next_sample, [this]() {
+        _int2_event = -1;
+        update();
+        update_int2();
+        // DRDY, WTM and ORun stay asserted until the master reads
+        bool latched = _int2_level != ((_regs[0x22] & 0x20) != 0);
+        if (!latched || (_regs[0x22] & 0x01)) {
+            schedule_int2();
+        }
+    });
+}
+
+bool L3GD20Model::write(const char *data, int length) {
+    if (length < 1) {
+        return true;
+    }
+    _ptr = data[0] & 0x7f;
+    _inc = data[0] & 0x80;
+    for (int i = 1; i < length; i++) {
+        update();
+        if (_ptr != 0x0f) {
+            _regs[_ptr & 0x3f] = data[i];
+        }
+        if (_ptr == 0x20) {
+            _next_sample = now_us() + period_us();
+        }
+        if (_ptr == 0x2e && (data[i] >> 5) == 0) {
+            _fifo_head = 0;     // bypass mode empties the FIFO
+            _fifo_level = 0;
+        }
+        if (_inc) _ptr++;
+    }
+    update_int2();
+    schedule_int2();
+    return true;
+}
+
+bool L3GD20Model::read(char *data, int length) {
+    update();
+    bool fifo_on = fifo_active();
+    for (int i = 0; i < length; i++) {
+        uint8_t r = _ptr & 0x3f;
+        if (fifo_on && r >= 0x28 && r <= 0x2d && _fifo_level > 0) {
+            data[i] = _fifo[_fifo_head][r - 0x28];
+        } else if (r == 0x2f) {
+            data[i] = fifo_src();
+        } else {
+            data[i] = _regs[r];
+        }
+        if (r == 0x2d) {
+            _regs[0x27] = 0;
+            if (fifo_on && _fifo_level > 0) {
+                _fifo_head = (_fifo_head + 1) % 32;
+                _fifo_level--;
+            }
+        }
+        if (_inc) {
+            // with the FIFO enabled the address rolls back to OUT_X_L
+            _ptr = (fifo_on && r == 0x2d) ? 0x28 : _ptr + 1;
+        }
+    }
+    update_int2();
+    schedule_int2();
+    return true;
+}
+
+/*********** board *****************/
+LSM303DLHCModel& board_lsm303() {
+    static LSM303DLHCModel m;
+    return m;
+}
+
+L3GD20Model& board_l3gd20() {
+    static L3GD20Model m;
+    return m;
+}
+
+void attach_board_sensors(PinName sda) {
+    if (sda != p28) {
+        return;
+    }
+    i2c_attach(sda, ACC_ADDR, board_lsm303().accel());
+    i2c_attach(sda, MAG_ADDR, board_lsm303().mag());
+    i2c_attach(sda, GYRO_ADDR, &board_l3gd20());
+    board_l3gd20().set_int2_pin(p29);
+}
+
+} // namespace mbed_host
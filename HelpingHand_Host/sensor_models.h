@@ -0,0 +1,142 @@
+/**
+* Register-level models of the glove's I2C sensors for the host build.
+*
+* Both models keep a 64-byte register file, honour the sub-address
+* auto-increment bit and produce a new output sample every ODR period of
+* virtual time from a scriptable motion source, so driver code exercises the
+* same register sequences it would on the board.
+*/
+#ifndef MBED_HOST_SENSOR_MODELS_H
+#define MBED_HOST_SENSOR_MODELS_H
+
+#include "mbed_host.h"
+
+namespace mbed_host {
+
+/** Physical signal at virtual time t_us, three axes */
+typedef std::function<void(uint64_t t_us, float v[3])> MotionSource;
+
+/** Scalar signal at virtual time t_us */
+typedef std::function<float(uint64_t t_us)> ScalarSource;
+
+/** LSM303DLHC: accelerometer at 0x32, magnetometer at 0x3c */
+class LSM303DLHCModel {
+public:
+    LSM303DLHCModel();
+
+    /** Acceleration in g */
+    void set_accel(MotionSource src) { _acc_src = src; }
+
+    /** Magnetic field in gauss */
+    void set_mag(MotionSource src) { _mag_src = src; }
+
+    I2CDevice* accel() { return &_acc; }
+    I2CDevice* mag() { return &_mag; }
+
+    uint8_t accel_reg(uint8_t addr) { return _acc.regs[addr & 0x3f]; }
+    uint8_t mag_reg(uint8_t addr) { return _mag.regs[addr & 0x3f]; }
+
+    /** Accelerometer samples produced since reset */
+    uint64_t accel_samples() { return _acc.samples; }
+
+    /** Accelerometer samples waiting in the FIFO */
+    int accel_fifo_level() { return _acc.fifo_level; }
+
+private:
+    struct Accel : public I2CDevice {
+        Accel(LSM303DLHCModel *m);
+        virtual bool write(const char *data, int length);
+        virtual bool read(char *data, int length);
+        void update();
+        void produce(uint64_t t);
+        uint64_t period_us();
+        bool fifo_active();
+        uint8_t fifo_src();
+
+        LSM303DLHCModel *model;
+        uint8_t regs[64];
+        uint8_t ptr;
+        bool inc;
+        uint64_t next_sample;
+        uint64_t samples;
+        uint8_t fifo[32][6];    // 32 level FIFO, OUT_X_L_A..OUT_Z_H_A per level
+        int fifo_head;
+        int fifo_level;
+    };
+
+    struct Mag : public I2CDevice {
+        Mag(LSM303DLHCModel *m);
+        virtual bool write(const char *data, int length);
+        virtual bool read(char *data, int length);
+        void produce();
+
+        LSM303DLHCModel *model;
+        uint8_t regs[64];
+        uint8_t ptr;
+    };
+
+    MotionSource _acc_src;
+    MotionSource _mag_src;
+    Accel _acc;
+    Mag _mag;
+};
+
+/** L3GD20 gyroscope at 0xd6 (SA0 high) */
+class L3GD20Model : public I2CDevice {
+public:
+    L3GD20Model();
+
+    /** Angular rate in degrees per second, including any zero-rate offset */
+    void set_rate(MotionSource src) { _rate_src = src; }
+
+    /** Die temperature in degrees C */
+    void set_temperature(ScalarSource src) { _temp_src = src; }
+
+    virtual bool write(const char *data, int length);
+    virtual bool read(char *data, int length);
+
+    uint8_t reg(uint8_t addr) { return _regs[addr & 0x3f]; }
+
+    /** Gyro samples produced since reset */
+    uint64_t samples() { return _samples; }
+
+    /** Gyro samples waiting in the FIFO */
+    int fifo_level() { return _fifo_level; }
+
+    /** MCU pin the DRDY/INT2 output is wired to */
+    void set_int2_pin(PinName pin) { _int2 = pin; }
+
+private:
+    void update();
+    void produce(uint64_t t);
+    uint64_t period_us();
+    bool fifo_active();
+    uint8_t fifo_src();
+    void update_int2();
+    void schedule_int2();
+
+    MotionSource _rate_src;
+    ScalarSource _temp_src;
+    uint8_t _regs[64];
+    uint8_t _ptr;
+    bool _inc;
+    uint64_t _next_sample;
+    uint64_t _samples;
+    uint8_t _fifo[32][6];
+    int _fifo_head;
+    int _fifo_level;
+    PinName _int2;
+    int _int2_level;
+    int _int2_event;
+};
+
+/** The sensors soldered to the glove's I2C bus (p28/p27), gyro INT2 on p29 */
+LSM303DLHCModel& board_lsm303();
+L3GD20Model& board_l3gd20();
+
+/** Called by the simulation when the bus on sda is first used */
+void attach_board_sensors(PinName sda);
+
+} // namespace mbed_host
+
+#endif
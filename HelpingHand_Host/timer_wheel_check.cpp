@@ -0,0 +1,142 @@
+/**
+* Off-target check of the TimerWheel on the virtual clock.
+*
+* 400 one-shot timers are armed, re-armed and cancelled at random, with
+* delays on every wheel level, then 400 timers are armed on the same
+* tick. Every timer must fire exactly on its tick, never after it was
+* cancelled, and arming must not get slower as a slot fills up.
+* Build and run with
+*
+*   g++ -std=c++11 -O2 -funsigned-char -IHelpingHand_Host
+*       -IHelpingHand_Menu/TimerWheel HelpingHand_Host/timer_wheel_check.cpp
+*       HelpingHand_Menu/TimerWheel/TimerWheel.cpp
+*       HelpingHand_Host/mbed_host.cpp HelpingHand_Host/sensor_models.cpp
+*       -o timer_wheel_check && ./timer_wheel_check
+*
+* It prints a summary and exits with 1 if anything was off.
+*/
+#define MBED_HOST_KEEP_MAIN
+#include "mbed_host.h"
+#include "TimerWheel.h"
+#include <chrono>
+
+using namespace mbed_host;
+
+namespace {
+
+const int TIMERS = 400;
+const int ROUNDS = 20000;
+
+TimerWheel wheel;
+WheelTicker *timer[TIMERS];
+uint32_t expect[TIMERS];    //us_ticker_read() the timer is due at
+bool armed[TIMERS];
+int fired;
+int errors;
+
+void fire(int i) {
+    uint32_t now = us_ticker_read();
+
+    if (!armed[i] || now != expect[i]) {
+        if (errors < 10)
+            printf("timer %d fired at %u, expected %u, armed %d\r\n",
+                   i, now, expect[i], armed[i]);
+        errors++;
+    }
+    armed[i] = false;
+    fired++;
+}
+
+// the callbacks take no argument, one function per timer
+void (*callback[TIMERS])(void);
+
+template<int I> struct Callbacks {
+    static void fn() { fire(I); }
+    static void fill() {
+        callback[I] = &fn;
+        Callbacks<I + 1>::fill();
+    }
+};
+
+template<> struct Callbacks<TIMERS> {
+    static void fill() {}
+};
+
+/** delay_us from now, rounded up to whole ticks of the wheel */
+void arm(int i, uint32_t t0, uint32_t delay_us) {
+    uint32_t tick = (us_ticker_read() - t0) / TIMER_TICK_US;
+    uint32_t ticks = (delay_us + TIMER_TICK_US - 1) / TIMER_TICK_US;
+
+    expect[i] = t0 + (tick + (ticks ? ticks : 1)) * TIMER_TICK_US;
+    armed[i] = true;
+    timer[i]->once_us(callback[i], delay_us);
+}
+
+double wall_now() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** host time of one arm of timer i, 5 ms from now */
+double arm_cost(uint32_t t0, int i) {
+    const int reps = 2000;
+    double w0 = wall_now();
+
+    for (int r = 0; r < reps; r++)
+        arm(i, t0, 5000);
+    return (wall_now() - w0) / reps;
+}
+
+} // namespace
+
+int main() {
+    set_time_limit(UINT64_MAX);
+    Callbacks<0>::fill();
+    for (int i = 0; i < TIMERS; i++)
+        timer[i] = new WheelTicker(wheel);
+    srand(7);
+
+    //random arm, re-arm and cancel, a quarter on the upper levels
+    uint32_t t0 = us_ticker_read();
+    int arms = 0, cancels = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        wait_us(rand() % 3000);
+        int i = rand() % TIMERS;
+        if (armed[i] && rand() % 3 == 0) {
+            timer[i]->detach();
+            armed[i] = false;
+            cancels++;
+            continue;
+        }
+        arm(i, t0, rand() % 4 == 0 ? rand() % 40000000 : rand() % 200000);
+        arms++;
+    }
+    wait_ms(50000);
+    int pending = 0;
+    for (int i = 0; i < TIMERS; i++)
+        if (armed[i])
+            pending++;
+    printf("random: %d arms, %d cancels, %d fired, %d late or early, %d never fired\r\n",
+           arms, cancels, fired, errors, pending);
+    if (pending)
+        errors++;
+
+    //all on one tick: they fire together, arming cost does not grow;
+    //the wheel keeps its tick grid, so t0 stays
+    fired = 0;
+    double first = arm_cost(t0, 0);
+    for (int i = 1; i < TIMERS - 1; i++)
+        arm(i, t0, 5000);
+    double last = arm_cost(t0, TIMERS - 1);
+    wait_ms(10);
+    printf("one slot: %d of %d fired, arm %.3f us alone, %.3f us with %d others\r\n",
+           fired, TIMERS, first * 1e6, last * 1e6, TIMERS - 1);
+    if (fired != TIMERS)
+        errors++;
+    if (last > 3 * first) {
+        printf("arming slows down as the slot fills\r\n");
+        errors++;
+    }
+    printf("%s\r\n", errors ? "FAILED" : "ok");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+/**
+* Background scan of the analog inputs, see AdcScan.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "AdcScan.h"
+
+//pins of AD0.0 to AD0.5, the index is the ADC channel
+static const PinName adc_pins[ADC_SCAN_CHANNELS] = {p15, p16, p17, p18, p19, p20};
+
+#if defined(TARGET_LPC1768)
+//ADCR bits
+#define ADC_BURST (1UL << 16)
+#define ADC_PDN   (1UL << 21)
+//ADINTEN bit, the request follows the global DONE only
+#define ADC_GINTEN (1UL << 8)
+//ADGDR bits
+#define ADC_DONE  (1UL << 31)
+#define ADC_CHN(r)    (((r) >> 24) & 0x7)
+#define ADC_RESULT(r) (((r) >> 4) & 0xfff)
+#define ADC_CLOCKS 65               //ADC clocks per conversion
+#define ADC_MAX_HZ 13000000         //fastest ADC clock
+//GPDMA, UM10360 chapter 31
+#define DMA_ADC_REQUEST 4           //peripheral number of the ADC
+#define DMA_P2M (2UL << 11)         //peripheral to memory, DMA flow control
+#define DMA_WORD 2                  //32 bit transfers
+#define DMA_DI (1UL << 27)          //increment destination
+
+struct DmaLli {
+    uint32_t src;
+    uint32_t dst;
+    uint32_t next;
+    uint32_t control;
+};
+
+//the GPDMA cannot reach the main SRAM
+static volatile uint32_t adc_ring[ADC_SCAN_RING] __attribute__((section("AHBSRAM0"), aligned(4)));
+static DmaLli adc_lli __attribute__((section("AHBSRAM0"), aligned(4)));
+#define ADC_DMA LPC_GPDMACH7        //lowest priority channel
+#endif
+
+AdcScan::AdcScan()
+{
+    _slots = 0;
+    _burst = false;
+}
+
+int AdcScan::add(PinName pin)
+{
+    if (_slots == ADC_SCAN_CHANNELS)
+        return -1;
+    for (int c = 0; c < ADC_SCAN_CHANNELS; c++) {
+        if (adc_pins[c] == pin) {
+            _in[_slots] = new AnalogIn(pin);
+            _channel[_slots] = c;
+            _last[_slots] = 0;
+            return _slots++;
+        }
+    }
+    return -1;
+}
+
+void AdcScan::start()
+{
+#if defined(TARGET_LPC1768)
+    uint32_t sel = 0;
+    uint32_t pclk;
+    uint32_t div;
+
+    if (_slots == 0)
+        return;
+    for (int i = 0; i < _slots; i++)
+        sel |= 1UL << _channel[i];
+    for (int i = 0; i < ADC_SCAN_RING; i++)
+        adc_ring[i] = 0;
+
+    //ring of results, the LLI links back to itself so the DMA never stops
+    LPC_SC->PCONP |= 1UL << 29;
+    LPC_GPDMA->DMACConfig = 1;
+    adc_lli.src = (uint32_t)&LPC_ADC->ADGDR;
+    adc_lli.dst = (uint32_t)adc_ring;
+    adc_lli.next = (uint32_t)&adc_lli;
+    adc_lli.control = ADC_SCAN_RING | (DMA_WORD << 18) | (DMA_WORD << 21) | DMA_DI;
+    ADC_DMA->DMACCConfig = 0;
+    LPC_GPDMA->DMACIntTCClear = 1UL << 7;
+    LPC_GPDMA->DMACIntErrClr = 1UL << 7;
+    ADC_DMA->DMACCSrcAddr = adc_lli.src;
+    ADC_DMA->DMACCDestAddr = adc_lli.dst;
+    ADC_DMA->DMACCLLI = adc_lli.next;
+    ADC_DMA->DMACCControl = adc_lli.control;
+    ADC_DMA->DMACCConfig = 1 | (DMA_ADC_REQUEST << 1) | DMA_P2M;
+
+    //ADC clock for ADC_SCAN_HZ per channel, from PCLK_ADC
+    switch ((LPC_SC->PCLKSEL0 >> 24) & 3) {
+        case 0: pclk = SystemCoreClock / 4; break;
+        case 1: pclk = SystemCoreClock; break;
+        case 2: pclk = SystemCoreClock / 2; break;
+        default: pclk = SystemCoreClock / 8; break;
+    }
+    div = pclk / (ADC_CLOCKS * ADC_SCAN_HZ * _slots);
+    if (div * ADC_MAX_HZ < pclk)
+        div = (pclk + ADC_MAX_HZ - 1) / ADC_MAX_HZ;
+    if (div > 256)
+        div = 256;
+    if (div < 1)
+        div = 1;
+
+    //every conversion requests the DMA through the global DONE, which the
+    //DMA's read of ADGDR clears; the per channel DONE flags are never read,
+    //enabled they would hold the request up. The NVIC line stays off
+    NVIC_DisableIRQ(ADC_IRQn);
+    LPC_ADC->ADINTEN = ADC_GINTEN;
+    LPC_ADC->ADCR = sel | ((div - 1) << 8) | ADC_BURST | ADC_PDN;
+    _burst = true;
+#endif
+}
+
+unsigned short AdcScan::read_u16(int slot)
+{
+    if (slot < 0 || slot >= _slots)
+        return 0;
+#if defined(TARGET_LPC1768)
+    if (_burst) {
+        //walk back from the result the DMA wrote last
+        int i = (ADC_DMA->DMACCDestAddr - (uint32_t)adc_ring) / 4;
+        uint32_t sum = 0;
+        int n = 0;
+
+        for (int k = 1; k < ADC_SCAN_RING && n < ADC_OVERSAMPLE; k++) {
+            uint32_t r = adc_ring[(i - k) & (ADC_SCAN_RING - 1)];
+            if ((r & ADC_DONE) && ADC_CHN(r) == (uint32_t)_channel[slot]) {
+                sum += ADC_RESULT(r);
+                n++;
+            }
+        }
+        //none in the window, the scan is slow or another channel's
+        //burst filled the ring: the last level is still the best one
+        if (n == 0)
+            return _last[slot];
+        sum /= n;
+        _last[slot] = (sum << 4) | (sum >> 8);  //12 to 16 bits, as AnalogIn
+        return _last[slot];
+    }
+#endif
+    return _in[slot]->read_u16();
+}
+
+float AdcScan::read(int slot)
+{
+    return read_u16(slot) * (1.0f / 65535.0f);
+}
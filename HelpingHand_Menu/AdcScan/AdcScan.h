@@ -0,0 +1,61 @@
+/**
+* Background scan of the analog inputs
+*
+* On the LPC1768 the ADC runs in burst mode over every channel that was
+* added, and GPDMA copies each result (ADGDR, tagged with its channel)
+* into a ring in AHB SRAM, circling through one self-linked LLI. Nothing
+* interrupts the CPU. read_u16() averages the newest ADC_OVERSAMPLE
+* results of its channel from the ring, so a read is a few memory loads
+* and is safe from any ISR. The LPC1768 ADC has no averaging of its own,
+* the oversampling is this average.
+*
+* Elsewhere (and on the host build) read_u16() is a blocking AnalogIn
+* conversion, so the same code runs without the ADC registers.
+*
+* @code
+* AdcScan adc;
+* int battery = adc.add(p15);
+* adc.start();
+* float v = adc.read(battery);
+* @endcode
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef ADCSCAN_H
+#define ADCSCAN_H
+
+#include "mbed.h"
+
+#define ADC_SCAN_CHANNELS 6     //p15 to p20, AD0.0 to AD0.5
+#define ADC_SCAN_HZ 2000        //conversions per second of each channel
+#define ADC_SCAN_RING 64        //results kept by the DMA
+#define ADC_OVERSAMPLE 8        //results averaged per read
+
+class AdcScan {
+public:
+    AdcScan();
+
+    /** add an analog pin to the scan, before start()
+     *
+     * @return the slot to read it with, -1 if pin has no ADC channel
+     */
+    int add(PinName pin);
+
+    /** start scanning the added pins */
+    void start();
+
+    /** averaged level of a slot, 0 to 0xffff like AnalogIn::read_u16() */
+    unsigned short read_u16(int slot);
+
+    /** averaged level of a slot, 0.0 to 1.0 */
+    float read(int slot);
+
+private:
+    AnalogIn *_in[ADC_SCAN_CHANNELS];   //mbed sets up pin, power and clock
+    int _channel[ADC_SCAN_CHANNELS];    //ADC channel of each slot
+    unsigned short _last[ADC_SCAN_CHANNELS];    //last averaged level
+    int _slots;
+    bool _burst;                        //results come from the DMA ring
+};
+
+#endif
@@ -0,0 +1,52 @@
+/**
+* Lock-free queue of timestamped events from the ISRs to the main loop
+*
+* ISRs push() a compact event (type, argument and the us_ticker_read()
+* time it happened), the main loop pop()s them in batches and applies
+* them, so state shared with the main loop is only ever written there.
+*
+* One producer and one consumer, no interrupts are disabled: the slot is
+* written before the head index moves and read before the tail moves.
+* The mbed ISRs all run at the default NVIC priority, they never
+* interrupt each other and together are the single producer. An event
+* pushed while the queue is full is dropped and counted.
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef EVENTFIFO_H
+#define EVENTFIFO_H
+
+#include "mbed.h"
+
+#define EVENT_FIFO_SIZE 32      //queued events (power of 2)
+
+struct Event {
+    uint32_t t;                 //us_ticker_read() when pushed
+    uint8_t type;
+    uint8_t arg;
+};
+
+class EventFifo {
+public:
+    EventFifo();
+
+    /** queue an event, from an ISR */
+    void push(uint8_t type, uint8_t arg = 0);
+
+    /** take up to max events, oldest first, from the main loop
+     *
+     * @return number of events copied to ev
+     */
+    int pop(Event *ev, int max);
+
+    /** events dropped because the queue was full */
+    uint32_t lost();
+
+private:
+    Event _ev[EVENT_FIFO_SIZE];
+    volatile int _head;         //written by push() only
+    volatile int _tail;         //written by pop() only
+    volatile uint32_t _lost;
+};
+
+#endif
@@ -0,0 +1,139 @@
+/**
+* Framed binary glove-to-hub protocol, see HubFrame.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "HubFrame.h"
+
+//CRC-16/CCITT, one nibble at a time
+static const uint16_t crc_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+uint16_t frame_crc16(const uint8_t *data, int length, uint16_t crc)
+{
+    for (int i = 0; i < length; i++) {
+        crc = (crc << 4) ^ crc_nibble[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc_nibble[(crc >> 12) ^ (data[i] & 0x0f)];
+    }
+    return crc;
+}
+
+HubFrame::HubFrame(Serial &port):
+    _port(&port)
+{
+    _len = 0;
+    _seq = 0;
+    _tx_head = 0;
+    _tx_tail = 0;
+    _tx_busy = false;
+    _dropped = 0;
+    _port->attach(this, &HubFrame::tx, Serial::TxIrq);
+}
+
+void HubFrame::begin(uint8_t type)
+{
+    uint32_t t = us_ticker_read();
+
+    _buf[0] = FRAME_SYNC0;
+    _buf[1] = FRAME_SYNC1;
+    _buf[2] = 0;
+    _buf[3] = type;
+    _buf[4] = _seq;
+    _buf[5] = t;
+    _buf[6] = t >> 8;
+    _buf[7] = t >> 16;
+    _buf[8] = t >> 24;
+    _len = FRAME_HEADER;
+}
+
+void HubFrame::put_u8(uint8_t v)
+{
+    if (_len < FRAME_HEADER + FRAME_MAX_PAYLOAD)
+        _buf[_len++] = v;
+}
+
+void HubFrame::put_u16(uint16_t v)
+{
+    put_u8(v);
+    put_u8(v >> 8);
+}
+
+void HubFrame::put_i16(int16_t v)
+{
+    put_u16((uint16_t)v);
+}
+
+void HubFrame::put_u32(uint32_t v)
+{
+    put_u16(v);
+    put_u16(v >> 16);
+}
+
+int HubFrame::space()
+{
+    return FRAME_HEADER + FRAME_MAX_PAYLOAD - _len;
+}
+
+int HubFrame::send()
+{
+    uint16_t crc;
+    int n;
+
+    if (_len < FRAME_HEADER)
+        return 0;
+    _buf[2] = _len - FRAME_HEADER;
+    crc = frame_crc16(&_buf[2], _len - 2);
+    _buf[_len++] = crc;
+    _buf[_len++] = crc >> 8;
+    n = _len;
+    _len = 0;
+    _seq++;
+    if (n > tx_free()) {
+        _dropped++;
+        return 0;
+    }
+    int head = _tx_head;
+    for (int i = 0; i < n; i++) {
+        _tx_buf[head] = _buf[i];
+        head = (head + 1) & (FRAME_TX_BUFFER - 1);
+    }
+    _tx_head = head;
+    //start the UART if the last TX interrupt found the queue empty
+    __disable_irq();
+    if (!_tx_busy)
+        tx();
+    __enable_irq();
+    return n;
+}
+
+//TX interrupt: the UART FIFO is empty, refill it from the queue
+void HubFrame::tx()
+{
+    int tail = _tx_tail;
+    int n = 0;
+
+    while (tail != _tx_head && n < FRAME_UART_FIFO) {
+        _port->putc(_tx_buf[tail]);
+        tail = (tail + 1) & (FRAME_TX_BUFFER - 1);
+        n++;
+    }
+    _tx_tail = tail;
+    _tx_busy = n > 0;
+}
+
+uint8_t HubFrame::sequence()
+{
+    return _seq;
+}
+
+int HubFrame::tx_free()
+{
+    return FRAME_TX_BUFFER - 1 - ((_tx_head - _tx_tail) & (FRAME_TX_BUFFER - 1));
+}
+
+int HubFrame::dropped()
+{
+    return _dropped;
+}
@@ -0,0 +1,94 @@
+/**
+* Framed binary glove-to-hub protocol
+*
+* Every message to the hub is one frame:
+*
+*   0xA5 0x5A | len | type | seq | time (4) | payload (len) | crc (2)
+*
+* len counts the payload bytes only, seq goes up by one per frame so the
+* hub can spot lost frames, time is us_ticker_read() when the frame was
+* started. Multi-byte fields are little endian. crc is CRC-16/CCITT
+* (poly 0x1021, init 0xffff) over len..payload, so a frame never depends
+* on a delimiter byte and a corrupted frame is dropped instead of being
+* decoded as a command. The matching decoder is FrameDecoder in
+* helping_hand.py.
+*
+* send() does not wait for the UART: finished frames are copied into a
+* FRAME_TX_BUFFER byte queue that the TX interrupt (THRE, FIFO empty)
+* drains FRAME_UART_FIFO bytes at a time. A frame that does not fit is
+* dropped whole and counted, its seq is still used up so the hub sees
+* the gap.
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef HUBFRAME_H
+#define HUBFRAME_H
+
+#include "mbed.h"
+
+#define FRAME_SYNC0 0xa5
+#define FRAME_SYNC1 0x5a
+#define FRAME_HEADER 9          //sync, len, type, seq, time
+#define FRAME_MAX_PAYLOAD 128
+#define FRAME_MAX (FRAME_HEADER + FRAME_MAX_PAYLOAD + 2)
+#define FRAME_TX_BUFFER 512     //queued bytes, power of 2
+#define FRAME_UART_FIFO 16      //bytes the UART takes per TX interrupt
+
+//frame types
+#define FRAME_COMMAND 0x01      //game command, see SendCommand() in main.cpp
+#define FRAME_TELEMETRY 0x02    //sensor samples, see SendTelemetry() in main.cpp
+
+/** CRC-16/CCITT of length bytes, continuing from crc */
+uint16_t frame_crc16(const uint8_t *data, int length, uint16_t crc = 0xffff);
+
+class HubFrame {
+public:
+    /** Create an encoder writing to port
+     *
+     * @param port is the UART the hub radio is on
+     */
+    HubFrame(Serial &port);
+
+    /** start a new frame, drops one that was not sent */
+    void begin(uint8_t type);
+
+    /** append payload fields, ignored once FRAME_MAX_PAYLOAD is reached */
+    void put_u8(uint8_t v);
+    void put_u16(uint16_t v);
+    void put_i16(int16_t v);
+    void put_u32(uint32_t v);
+
+    /** payload bytes that still fit in the current frame */
+    int space();
+
+    /** finish the frame (length, crc) and queue it for the port
+     *
+     * @return number of bytes queued, 0 if the queue was too full
+     */
+    int send();
+
+    /** frames sent so far, the next frame carries this as seq */
+    uint8_t sequence();
+
+    /** bytes that can be queued without dropping a frame */
+    int tx_free();
+
+    /** frames dropped because the queue was full */
+    int dropped();
+
+private:
+    void tx();
+
+    Serial *_port;
+    uint8_t _buf[FRAME_MAX];
+    int _len;
+    uint8_t _seq;
+
+    uint8_t _tx_buf[FRAME_TX_BUFFER];
+    volatile int _tx_head;      //written by send() only
+    volatile int _tx_tail;      //written by tx() only
+    volatile bool _tx_busy;     //a TX interrupt is still to come
+    int _dropped;
+};
+
+#endif
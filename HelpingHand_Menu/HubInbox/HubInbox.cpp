@@ -0,0 +1,72 @@
+/**
+* Messages from the hub, see HubInbox.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "HubInbox.h"
+
+HubInbox::HubInbox(Serial &port, void (*received)(void)) : _port(port)
+{
+    _received = received;
+    for (int i = 0; i < HUB_MESSAGES; i++)
+        _handlers[i] = NULL;
+    _head = 0;
+    _tail = 0;
+    _lost = 0;
+    _unknown = 0;
+    _port.attach(this, &HubInbox::rx, Serial::RxIrq);
+}
+
+void HubInbox::on(uint8_t msg, HubHandler fn)
+{
+    if (msg < HUB_MESSAGES)
+        _handlers[msg] = fn;
+}
+
+/**
+* RX interrupt, empties the UART FIFO into the buffer
+*/
+void HubInbox::rx()
+{
+    int head = _head;
+
+    while (_port.readable()) {
+        uint8_t c = _port.getc();
+        int next = (head + 1) & (HUB_RX_BUFFER - 1);
+        if (next == _tail) {
+            _lost++;
+            continue;
+        }
+        _buf[head] = c;
+        head = next;
+    }
+    _head = head;   //publish after the bytes are written
+    if (_received != NULL)
+        _received();
+}
+
+int HubInbox::dispatch()
+{
+    int n = 0;
+
+    while (_tail != _head) {
+        uint8_t msg = _buf[_tail];
+        _tail = (_tail + 1) & (HUB_RX_BUFFER - 1);  //free before the handler runs
+        n++;
+        if (msg < HUB_MESSAGES && _handlers[msg] != NULL)
+            _handlers[msg](msg);
+        else
+            _unknown++;
+    }
+    return n;
+}
+
+uint32_t HubInbox::lost()
+{
+    return _lost;
+}
+
+uint32_t HubInbox::unknown()
+{
+    return _unknown;
+}
@@ -0,0 +1,69 @@
+/**
+* Messages from the hub: interrupt-driven receive and dispatch
+*
+* The hub sends one byte per message (the Response bits in
+* helping_hand.py). The UART RX interrupt moves every received byte into
+* a ring buffer, so none is lost or taken by the wrong reader however
+* long the main loop is busy, and calls the received callback (to post
+* the task that dispatches). dispatch() then hands each message, in
+* order, to the handler registered for its value with on().
+*
+* One producer (the RX ISR) and one consumer (dispatch()), lock-free.
+*
+* @code
+* HubInbox inbox(xbee, &wake);
+* inbox.on(4, &exitPressed);
+* ...
+* inbox.dispatch();      //from the main loop
+* @endcode
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef HUBINBOX_H
+#define HUBINBOX_H
+
+#include "mbed.h"
+
+#define HUB_RX_BUFFER 32        //received bytes waiting (power of 2)
+#define HUB_MESSAGES 8          //message values 0 to HUB_MESSAGES - 1
+
+typedef void (*HubHandler)(uint8_t msg);
+
+class HubInbox {
+public:
+    /** Create a receiver and attach it to the port's RX interrupt
+     *
+     * @param port is the UART the hub radio is on
+     * @param received is called from the ISR after bytes arrived, or NULL
+     */
+    HubInbox(Serial &port, void (*received)(void) = NULL);
+
+    /** call fn for every message msg, NULL to ignore msg */
+    void on(uint8_t msg, HubHandler fn);
+
+    /** hand the waiting messages to their handlers, not from an ISR
+     *
+     * @return number of messages taken
+     */
+    int dispatch();
+
+    /** bytes dropped because the buffer was full */
+    uint32_t lost();
+
+    /** messages without a handler */
+    uint32_t unknown();
+
+private:
+    void rx();
+
+    Serial &_port;
+    void (*_received)(void);
+    HubHandler _handlers[HUB_MESSAGES];
+    uint8_t _buf[HUB_RX_BUFFER];
+    volatile int _head;         //written by rx() only
+    volatile int _tail;         //written by dispatch() only
+    volatile uint32_t _lost;
+    uint32_t _unknown;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/**
+* Shared I2C bus manager
+*
+* One I2CBus owns the SDA/SCL pins and is handed to every driver on that
+* bus, so the drivers stop reconfiguring each other's clock. Each slave
+* address gets its own clock rate, transfers are queued and, on the
+* LPC1768's p28/p27 (I2C2), run from the I2C interrupt with a completion
+* callback. Elsewhere the queue is run with blocking mbed I2C calls from a
+* Timeout, so the same code works on other targets and the host build.
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#include "mbed.h"
+
+#define I2CBUS_MAX_DEVICES 4    //slave addresses with their own clock rate
+
+/** One queued bus transaction: optional write, then optional read after a
+* repeated start. Owned by the caller until done is called.
+*/
+struct I2CTransfer {
+    int address;            //8 bit slave address
+    const char *tx;         //bytes written first, usually a register address
+    int tx_length;
+    char *rx;               //buffer for bytes read after the write
+    int rx_length;
+    void (*done)(I2CTransfer *t);   //called from interrupt context, may be NULL
+    void *context;          //free for the caller
+    volatile int result;    //1 while queued, 0 on success, -1 on NACK/bus error
+    I2CTransfer *next;      //queue link, used by I2CBus
+};
+
+class I2CBus {
+public:
+    /** Create the bus manager
+     *
+     * @param sda is the pin for the I2C SDA line
+     * @param scl is the pin for the I2C SCL line
+     */
+    I2CBus(PinName sda, PinName scl);
+
+    /** set the clock rate used whenever address is talked to (default 100 kHz) */
+    void frequency(int address, int hz);
+
+    /** queue a transfer and return immediately
+     *
+     * @return false if the transfer is already queued
+     */
+    bool transfer(I2CTransfer *t);
+
+    /** blocking transfer, safe to call from interrupt context
+     *
+     * @return 0 on success, -1 on NACK/bus error
+     */
+    int transfer(int address, const char *tx, int tx_length, char *rx, int rx_length);
+
+    /** true while transfers are queued or running */
+    bool busy();
+
+private:
+    void start_next();
+    void finish(int result);
+    void apply_frequency(int address);
+    void step();
+    static void irq();
+
+    I2C _i2c;
+    int _addr[I2CBUS_MAX_DEVICES];
+    int _hz[I2CBUS_MAX_DEVICES];
+    int _current_hz;
+    I2CTransfer *volatile _head;    //running transfer
+    I2CTransfer *_tail;
+    int _tx_index;
+    int _rx_index;
+    bool _irq_mode;                 //driven from the I2C2 interrupt
+    Timeout _kick;                  //runs the queue when not in _irq_mode
+
+    static I2CBus *_instance;
+};
+
+#endif
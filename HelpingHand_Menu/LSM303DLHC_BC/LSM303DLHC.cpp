@@ -50,47 +50,73 @@ enum REG_ADDRS {
     /* --- Acc --- */
     CTRL_REG1_A = 0x20,
     CTRL_REG4_A = 0x23,
+    CTRL_REG5_A = 0x24,
     OUT_X_A     = 0x28,
     OUT_Y_A     = 0x2A,
     OUT_Z_A     = 0x2C,
+    FIFO_CTRL_REG_A = 0x2E,
+    FIFO_SRC_REG_A  = 0x2F,
+};
+
+/* sample period in us indexed by CTRL_REG1_A[7:4], 0 = power down */
+static const uint32_t acc_period_us[10] = {
+    0, 1000000, 100000, 40000, 20000, 10000, 5000, 2500, 617, 744
+};
+
+/* left justified counts per g indexed by CTRL_REG4_A[5:4], the datasheet
+   gives 1/2/4/12 mg per 12 bit LSB, so 16 g is not 2 g >> 3 */
+static const int32_t acc_lsb_per_g[4] = {
+    16384, 8192, 4096, 1333
 };
 
 bool LSM303DLHC::write_reg(int addr_i2c,int addr_reg, char v)
 {
     char data[2] = {addr_reg, v}; 
-    return LSM303DLHC::_LSM303.write(addr_i2c, data, 2) == 0;
+    return _LSM303->transfer(addr_i2c, data, 2, NULL, 0) == 0;
 }
 
 bool LSM303DLHC::read_reg(int addr_i2c,int addr_reg, char *v)
 {
     char data = addr_reg; 
-    bool result = false;
     
-    __disable_irq();
-    if ((_LSM303.write(addr_i2c, &data, 1) == 0) && (_LSM303.read(addr_i2c, &data, 1) == 0)){
+    if (_LSM303->transfer(addr_i2c, &data, 1, &data, 1) == 0){
         *v = data;
-        result = true;
+        return true;
     }
-    __enable_irq();
-    return result;
+    return false;
 }
 
 
-LSM303DLHC::LSM303DLHC(PinName sda, PinName scl):
-    _LSM303(sda, scl)
+LSM303DLHC::LSM303DLHC(PinName sda, PinName scl,
+                       uint8_t data_rate, uint8_t fullscale, uint8_t mode):
+    _LSM303(new I2CBus(sda, scl))
+{
+    init(data_rate, fullscale, mode);
+}
+
+LSM303DLHC::LSM303DLHC(I2CBus &bus,
+                       uint8_t data_rate, uint8_t fullscale, uint8_t mode):
+    _LSM303(&bus)
+{
+    init(data_rate, fullscale, mode);
+}
+
+void LSM303DLHC::init(uint8_t data_rate, uint8_t fullscale, uint8_t mode)
 {
     char reg_v;
-    _LSM303.frequency(100000);
-        
-    reg_v = 0;
-    
-    reg_v |= 0x27;          /* X/Y/Z axis enable. */
-    write_reg(addr_acc,CTRL_REG1_A,reg_v);
+    /* both halves of the chip support 400kHz fast mode */
+    _LSM303->frequency(addr_acc, 400000);
+    _LSM303->frequency(addr_mag, 400000);
 
-    reg_v = 0;
-   // reg_v |= 0x01 << 6;     /* 1: data MSB @ lower address */
-    reg_v = 0x01 << 4;     /* +/- 4g */
-    write_reg(addr_acc,CTRL_REG4_A,reg_v);
+    _drain.address = addr_acc;
+    _drain.tx = &_drain_sub;
+    _drain.tx_length = 1;
+    _drain.rx = _drain_buf;
+    _drain.done = &LSM303DLHC::drain_done;
+    _drain.context = this;
+    _drain.result = 0;
+
+    configure(data_rate, fullscale, mode);
 
     /* -- mag --- */
     reg_v = 0;
@@ -107,13 +133,52 @@ LSM303DLHC::LSM303DLHC(PinName sda, PinName scl):
 }
 
 
+bool LSM303DLHC::configure(uint8_t data_rate, uint8_t fullscale, uint8_t mode)
+{
+    char reg_v;
+
+    if (data_rate > LSM303DLHC_ODR_1344HZ)
+        data_rate = LSM303DLHC_ODR_1344HZ;
+    /* 1.620 kHz only exists in low power mode */
+    if (data_rate == LSM303DLHC_ODR_1620HZ && mode != LSM303DLHC_LOW_POWER)
+        data_rate = LSM303DLHC_ODR_1344HZ;
+    fullscale &= 0x03;
+    _data_rate = data_rate;
+    _mode = mode;
+    _lsb_per_g = acc_lsb_per_g[fullscale];
+
+    reg_v = data_rate << 4;
+    if (mode == LSM303DLHC_LOW_POWER)
+        reg_v |= 0x08;
+    reg_v |= 0x07;          /* X/Y/Z axis enable. */
+    if (!write_reg(addr_acc,CTRL_REG1_A,reg_v))
+        return false;
+
+    reg_v = fullscale << 4;
+    if (mode == LSM303DLHC_HIGH_RES)
+        reg_v |= 0x08;
+    return write_reg(addr_acc,CTRL_REG4_A,reg_v);
+}
+
+int32_t LSM303DLHC::scale()
+{
+    return _lsb_per_g;
+}
+
+uint32_t LSM303DLHC::period_us()
+{
+    if (_data_rate == LSM303DLHC_ODR_1344HZ && _mode == LSM303DLHC_LOW_POWER)
+        return 186;         /* 5.376 kHz */
+    return acc_period_us[_data_rate];
+}
+
 bool LSM303DLHC::read(float *ax, float *ay, float *az, float *mx, float *my, float *mz) {
     char acc[6], mag[6];
  
     if (recv(addr_acc, OUT_X_A, acc, 6) && recv(addr_mag, OUT_X_M, mag, 6)) {
-        *ax = float(short(acc[1] << 8 | acc[0]))/8192;  //32768/4=8192
-        *ay =  float(short(acc[3] << 8 | acc[2]))/8192;
-        *az =  float(short(acc[5] << 8 | acc[4]))/8192;
+        *ax = float(short(acc[1] << 8 | acc[0]))/_lsb_per_g;
+        *ay =  float(short(acc[3] << 8 | acc[2]))/_lsb_per_g;
+        *az =  float(short(acc[5] << 8 | acc[4]))/_lsb_per_g;
         //full scale magnetic readings are from -2048 to 2047
         //gain is x,y =1100; z = 980 LSB/gauss
         *mx = float(short(mag[0] << 8 | mag[1]))/1100;
@@ -127,17 +192,41 @@ bool LSM303DLHC::read(float *ax, float *ay, float *az, float *mx, float *my, flo
 }
 
 bool LSM303DLHC::read_xz(float *ax, float *az) {
-    char acc[6], mag[6];
+    char acc[6];
  
-    if (recv(addr_acc, OUT_X_A, acc, 6) && recv(addr_mag, OUT_X_M, mag, 6)) {
-        *ax = float(short(acc[1] << 8 | acc[0]))/8192;  //32768/4=8192
-//        *ay =  float(short(acc[3] << 8 | acc[2]))/8192;
-        *az =  float(short(acc[5] << 8 | acc[4]))/8192;
+    if (recv(addr_acc, OUT_X_A, acc, 6)) {
+        *ax = float(short(acc[1] << 8 | acc[0]))/_lsb_per_g;
+        *az =  float(short(acc[5] << 8 | acc[4]))/_lsb_per_g;
+ 
+        return true;
+    }
+ 
+    return false;
+}
+
+bool LSM303DLHC::read_acc(float *ax, float *ay, float *az) {
+    char acc[6];
+ 
+    if (recv(addr_acc, OUT_X_A, acc, 6)) {
+        *ax = float(short(acc[1] << 8 | acc[0]))/_lsb_per_g;
+        *ay =  float(short(acc[3] << 8 | acc[2]))/_lsb_per_g;
+        *az =  float(short(acc[5] << 8 | acc[4]))/_lsb_per_g;
+ 
+        return true;
+    }
+ 
+    return false;
+}
+
+bool LSM303DLHC::read_mag(float *mx, float *my, float *mz) {
+    char mag[6];
+ 
+    if (recv(addr_mag, OUT_X_M, mag, 6)) {
         //full scale magnetic readings are from -2048 to 2047
         //gain is x,y =1100; z = 980 LSB/gauss
-//        *mx = float(short(mag[0] << 8 | mag[1]))/1100;
-//        *mz = float(short(mag[2] << 8 | mag[3]))/980;
-//        *my = float(short(mag[4] << 8 | mag[5]))/1100;
+        *mx = float(short(mag[0] << 8 | mag[1]))/1100;
+        *mz = float(short(mag[2] << 8 | mag[3]))/980;
+        *my = float(short(mag[4] << 8 | mag[5]))/1100;
  
         return true;
     }
@@ -146,8 +235,146 @@ bool LSM303DLHC::read_xz(float *ax, float *az) {
 }
 
 
+bool LSM303DLHC::read_acc_raw(int16_t *acc) {
+    char raw[6];
+
+    if (recv(addr_acc, OUT_X_A, raw, 6)) {
+        acc[0] = short(raw[1] << 8 | raw[0]);
+        acc[1] = short(raw[3] << 8 | raw[2]);
+        acc[2] = short(raw[5] << 8 | raw[4]);
+
+        return true;
+    }
+
+    return false;
+}
+
+bool LSM303DLHC::read_mag_raw(int16_t *mag) {
+    char raw[6];
+
+    if (recv(addr_mag, OUT_X_M, raw, 6)) {
+        /* the magnetometer is big endian and ordered x, z, y */
+        mag[0] = short(raw[0] << 8 | raw[1]);
+        mag[2] = short(raw[2] << 8 | raw[3]);
+        mag[1] = short(raw[4] << 8 | raw[5]);
+
+        return true;
+    }
+
+    return false;
+}
+
+
+bool LSM303DLHC::fifo_stream(int watermark) {
+    char reg_v;
+
+    /* going through bypass mode empties the FIFO */
+    if (!write_reg(addr_acc,FIFO_CTRL_REG_A,0x00) || !read_reg(addr_acc,CTRL_REG5_A,&reg_v))
+        return false;
+    reg_v |= 0x01 << 6;     /* FIFO enable */
+    if (!write_reg(addr_acc,CTRL_REG5_A,reg_v))
+        return false;
+
+    reg_v = 0x02 << 6;      /* stream mode, oldest sample is overwritten when full */
+    reg_v |= watermark & 0x1f;
+    return write_reg(addr_acc,FIFO_CTRL_REG_A,reg_v);
+}
+
+bool LSM303DLHC::fifo_bypass() {
+    char reg_v;
+
+    if (!write_reg(addr_acc,FIFO_CTRL_REG_A,0x00) || !read_reg(addr_acc,CTRL_REG5_A,&reg_v))
+        return false;
+    reg_v &= ~(0x01 << 6);
+    return write_reg(addr_acc,CTRL_REG5_A,reg_v);
+}
+
+int LSM303DLHC::fifo_count() {
+    char src;
+
+    if (!recv(addr_acc, FIFO_SRC_REG_A, &src, 1))
+        return -1;
+    if (src & 0x40)         /* overrun, all 32 levels are full */
+        return LSM303DLHC_FIFO_DEPTH;
+    return src & 0x1f;
+}
+
+int LSM303DLHC::read_fifo(float *acc, int max) {
+    int16_t raw[LSM303DLHC_FIFO_DEPTH * 3];
+    int n = read_fifo_raw(raw, max);
+
+    for (int i = 0; i < n * 3; i++)
+        acc[i] = float(raw[i])/_lsb_per_g;
+    return n;
+}
+
+int LSM303DLHC::read_fifo_raw(int16_t *acc, int max) {
+    char raw[LSM303DLHC_FIFO_DEPTH * 6];
+    int n = fifo_count();
+
+    if (n > max)
+        n = max;
+    if (n <= 0)
+        return n;
+    /* with the FIFO on, the register address wraps from OUT_Z_H_A back
+       to OUT_X_L_A, so every queued sample comes out in one burst */
+    if (!recv(addr_acc, OUT_X_A, raw, n * 6))
+        return -1;
+    for (int i = 0; i < n; i++) {
+        char *s = &raw[i * 6];
+        acc[i * 3]     = short(s[1] << 8 | s[0]);
+        acc[i * 3 + 1] = short(s[3] << 8 | s[2]);
+        acc[i * 3 + 2] = short(s[5] << 8 | s[4]);
+    }
+    return n;
+}
+
+bool LSM303DLHC::read_fifo_async(int16_t *acc, int max, void (*done)(int n)) {
+    if (_drain.result == 1)
+        return false;
+    _drain_acc = acc;
+    _drain_max = max < LSM303DLHC_FIFO_DEPTH ? max : LSM303DLHC_FIFO_DEPTH;
+    _drain_fn = done;
+    _drain_sub = FIFO_SRC_REG_A;
+    _drain.rx_length = 1;
+    return _LSM303->transfer(&_drain);
+}
+
+void LSM303DLHC::drain_done(I2CTransfer *t) {
+    LSM303DLHC *a = (LSM303DLHC *)t->context;
+    char *s = a->_drain_buf;
+    int n;
+
+    if (t->result != 0) {
+        a->_drain_fn(-1);
+        return;
+    }
+    if (t->rx_length == 1) {
+        /* FIFO_SRC_REG_A is in, queue the burst for that many samples */
+        n = (s[0] & 0x40) ? LSM303DLHC_FIFO_DEPTH : (s[0] & 0x1f);
+        if (n > a->_drain_max)
+            n = a->_drain_max;
+        if (n <= 0) {
+            a->_drain_fn(0);
+            return;
+        }
+        a->_drain_sub = OUT_X_A | 0x80;
+        t->rx_length = n * 6;
+        a->_LSM303->transfer(t);    /* result was set before this call */
+        return;
+    }
+    n = t->rx_length / 6;
+    for (int i = 0; i < n; i++) {
+        s = &a->_drain_buf[i * 6];
+        a->_drain_acc[i * 3]     = short(s[1] << 8 | s[0]);
+        a->_drain_acc[i * 3 + 1] = short(s[3] << 8 | s[2]);
+        a->_drain_acc[i * 3 + 2] = short(s[5] << 8 | s[4]);
+    }
+    a->_drain_fn(n);
+}
+
 bool LSM303DLHC::recv(char sad, char sub, char *buf, int length) {
     if (length > 1) sub |= 0x80;
  
-    return _LSM303.write(sad, &sub, 1, true) == 0 && _LSM303.read(sad, buf, length) == 0;
+    return _LSM303->transfer(sad, &sub, 1, buf, length) == 0;
 }
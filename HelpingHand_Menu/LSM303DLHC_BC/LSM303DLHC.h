@@ -2,7 +2,36 @@
 #ifndef __LSM303DLHC_H
 #define __LSM303DLHC_H
 #include "mbed.h"
+#include "I2CBus.h"
 
+#define LSM303DLHC_FIFO_DEPTH 32    // accelerometer FIFO levels
+
+// accelerometer output data rate, CTRL_REG1_A[7:4]
+#define LSM303DLHC_ODR_1HZ      1
+#define LSM303DLHC_ODR_10HZ     2
+#define LSM303DLHC_ODR_25HZ     3
+#define LSM303DLHC_ODR_50HZ     4
+#define LSM303DLHC_ODR_100HZ    5
+#define LSM303DLHC_ODR_200HZ    6
+#define LSM303DLHC_ODR_400HZ    7
+#define LSM303DLHC_ODR_1620HZ   8   // low power mode only
+#define LSM303DLHC_ODR_1344HZ   9   // 5376 Hz in low power mode
+
+// accelerometer full scale, CTRL_REG4_A[5:4]
+#define LSM303DLHC_FS_2G        0
+#define LSM303DLHC_FS_4G        1
+#define LSM303DLHC_FS_8G        2
+#define LSM303DLHC_FS_16G       3
+
+// accelerometer resolution
+#define LSM303DLHC_NORMAL       0   // 10 bit
+#define LSM303DLHC_LOW_POWER    1   // 8 bit, CTRL_REG1_A LPen
+#define LSM303DLHC_HIGH_RES     2   // 12 bit, CTRL_REG4_A HR
+
+// raw sample scale at the default +/- 4g (left justified), see scale()
+#define LSM303DLHC_ACC_LSB_PER_G 8192
+#define LSM303DLHC_MAG_LSB_PER_GAUSS_XY 1100    // +/- 1.3 gauss
+#define LSM303DLHC_MAG_LSB_PER_GAUSS_Z 980
 
 
 class LSM303DLHC {
@@ -11,8 +40,33 @@ class LSM303DLHC {
          *
          * @param sda is the pin for the I2C SDA line
          * @param scl is the pin for the I2C SCL line
+         * @param data_rate is the accelerometer rate, LSM303DLHC_ODR_1HZ to LSM303DLHC_ODR_1344HZ
+         * @param fullscale is LSM303DLHC_FS_2G to LSM303DLHC_FS_16G
+         * @param mode is LSM303DLHC_NORMAL, LSM303DLHC_LOW_POWER or LSM303DLHC_HIGH_RES
          */
-        LSM303DLHC(PinName sda, PinName scl);
+        LSM303DLHC(PinName sda, PinName scl, uint8_t data_rate = LSM303DLHC_ODR_10HZ,
+                   uint8_t fullscale = LSM303DLHC_FS_4G, uint8_t mode = LSM303DLHC_NORMAL);
+
+        /** Create a new interface for an LSM303DLHC on a shared bus
+         *
+         * @param bus is the bus manager shared with the other devices on the line
+         * @param other parameters -> please see LSM303DLHC(PinName sda, PinName scl,...)
+         */
+        LSM303DLHC(I2CBus &bus, uint8_t data_rate = LSM303DLHC_ODR_10HZ,
+                   uint8_t fullscale = LSM303DLHC_FS_4G, uint8_t mode = LSM303DLHC_NORMAL);
+
+        /** change the accelerometer settings, the magnetometer is not touched
+         *
+         * samples already in the FIFO keep the old scale
+         * @param other parameters -> please see LSM303DLHC(PinName sda, PinName scl,...)
+         */
+         bool configure(uint8_t data_rate, uint8_t fullscale, uint8_t mode);
+
+        /** raw accelerometer counts per g for the full scale set */
+         int32_t scale();
+
+        /** accelerometer sample period in us for the data rate set */
+         uint32_t period_us();
 
   
         /** read the raw accelerometer and compass values
@@ -21,19 +75,106 @@ class LSM303DLHC {
          * @param mx,my,mz is the magnetometer 3d vector, written by the function
          */
          bool read(float *ax, float *ay, float *az, float *mx, float *my, float *mz);
+
+        /** read the accelerometer x and z axes only
+         *
+         * one 6 byte transfer, the magnetometer is not touched
+         */
          bool read_xz(float *ax, float *az);
 
+        /** read the accelerometer only
+         *
+         * @param ax,ay,az is the accelerometer 3d vector in g, written by the function
+         */
+         bool read_acc(float *ax, float *ay, float *az);
+
+        /** read the magnetometer only
+         *
+         * @param mx,my,mz is the magnetometer 3d vector in gauss, written by the function
+         */
+         bool read_mag(float *mx, float *my, float *mz);
+
+        /** read the accelerometer only, without conversion
+         *
+         * @param acc x,y,z in units of 1/scale() g, written by the function
+         */
+         bool read_acc_raw(int16_t *acc);
+
+        /** read the magnetometer only, without conversion
+         *
+         * @param mag x,y,z in units of 1/LSM303DLHC_MAG_LSB_PER_GAUSS_XY (x,y)
+         *        and 1/LSM303DLHC_MAG_LSB_PER_GAUSS_Z (z) gauss, written by the function
+         */
+         bool read_mag_raw(int16_t *mag);
+
+        /** put the accelerometer FIFO in stream mode
+         *
+         * new samples are queued at the output data rate, the oldest one is
+         * dropped once all 32 levels are full
+         * @param watermark FIFO level (0-31) that raises the WTM flag
+         */
+         bool fifo_stream(int watermark = 0);
+
+        /** turn the accelerometer FIFO off again (bypass mode) */
+         bool fifo_bypass();
+
+        /** number of accelerometer samples waiting in the FIFO, -1 on bus error */
+         int fifo_count();
+
+        /** drain the accelerometer FIFO with a single burst read
+         *
+         * @param acc buffer for max samples of x,y,z in g, written by the function
+         * @param max capacity of acc in samples
+         * @return number of samples written, -1 on bus error
+         */
+         int read_fifo(float *acc, int max);
+
+        /** drain the accelerometer FIFO, without conversion
+         *
+         * @param acc buffer for max samples of x,y,z in units of
+         *        1/scale() g, written by the function
+         * @param max capacity of acc in samples
+         * @return number of samples written, -1 on bus error
+         */
+         int read_fifo_raw(int16_t *acc, int max);
+
+        /** drain the accelerometer FIFO by queued bus transfers, without waiting
+         *
+         * FIFO_SRC_REG_A is read first, then the samples in one burst
+         * @param acc buffer for max samples of x,y,z in units of
+         *        1/scale() g, written before done is called
+         * @param max capacity of acc in samples
+         * @param done called from interrupt context with the number of
+         *        samples written, -1 on bus error
+         * @return false if the previous drain has not finished yet
+         */
+         bool read_fifo_async(int16_t *acc, int max, void (*done)(int n));
+
 
     private:
-        I2C _LSM303;
+        I2CBus *_LSM303;
 
          
         float ax, ay, az;
         float mx, my, mz;         
+
+        uint8_t _data_rate;
+        uint8_t _mode;
+        int32_t _lsb_per_g;
+
+        /* queued FIFO drain, FIFO_SRC_REG_A first, then the burst */
+        I2CTransfer _drain;
+        char _drain_sub;
+        char _drain_buf[LSM303DLHC_FIFO_DEPTH * 6];
+        int16_t *_drain_acc;
+        int _drain_max;
+        void (*_drain_fn)(int n);
          
+        void init(uint8_t data_rate, uint8_t fullscale, uint8_t mode);
         bool write_reg(int addr_i2c,int addr_reg, char v);
         bool read_reg(int addr_i2c,int addr_reg, char *v);
         bool recv(char sad, char sub, char *buf, int length);
+        static void drain_done(I2CTransfer *t);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+/**
+* Fixed-point wrist orientation, see Orientation.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "Orientation.h"
+
+#define CORDIC_SHIFT 12         //int16 input to CORDIC working range
+#define CORDIC_GAIN_Q15 19898   //1 / 1.64676, the CORDIC length gain
+
+//atan(2^-i) as binary angles
+static const int32_t cordic_atan[ORIENT_CORDIC_STEPS] = {
+    0x20000000, 0x12e4051e, 0x09fb385b, 0x051111d4,
+    0x028b0d43, 0x0145d7e1, 0x00a2f61e, 0x00517c55,
+    0x0028be53, 0x00145f2f, 0x000a2f98, 0x000517cc,
+    0x00028be6, 0x000145f3, 0x0000a2fa, 0x0000517d
+};
+
+int32_t orient_atan2(int32_t y, int32_t x, int32_t *mag)
+{
+    uint32_t a = 0;     //unsigned so the angle wraps instead of overflowing
+
+    //CORDIC converges within +-99 degrees, start from the right half
+    if (x < 0) {
+        x = -x;
+        y = -y;
+        a = 0x80000000;
+    }
+    for (int i = 0; i < ORIENT_CORDIC_STEPS; i++) {
+        int32_t xs = x >> i;
+        int32_t ys = y >> i;
+        if (y > 0) {
+            x += ys;
+            y -= xs;
+            a += cordic_atan[i];
+        } else {
+            x -= ys;
+            y += xs;
+            a -= cordic_atan[i];
+        }
+    }
+    if (mag != NULL)
+        *mag = ((int64_t)x * CORDIC_GAIN_Q15) >> 15;
+    return (int32_t)a;
+}
+
+int orient_cdeg(int32_t angle)
+{
+    return ((int64_t)angle * 18000) >> 31;
+}
+
+Orientation::Orientation(int sample_us, int gyro_udps, int acc_1g, int tau_ms)
+{
+    //constants are worked out once here, update() is integer only
+    _gyro_k = (int64_t)((double)gyro_udps * sample_us * 2147483648.0 * 65536.0 / 180e12);
+    _alpha = (int32_t)(32768.0 * sample_us / (tau_ms * 1000.0 + sample_us));
+    _acc_lo = (acc_1g << CORDIC_SHIFT) / 100 * (100 - ORIENT_ACC_GATE);
+    _acc_hi = (acc_1g << CORDIC_SHIFT) / 100 * (100 + ORIENT_ACC_GATE);
+    _roll = 0;
+    _pitch = 0;
+    _valid = false;
+}
+
+bool Orientation::tilt(const int16_t *acc, int32_t *roll, int32_t *pitch)
+{
+    int32_t ax = (int32_t)acc[0] << CORDIC_SHIFT;
+    int32_t ay = (int32_t)acc[1] << CORDIC_SHIFT;
+    int32_t az = (int32_t)acc[2] << CORDIC_SHIFT;
+    int32_t yz, g;
+
+    *roll = orient_atan2(ay, az, &yz);
+    *pitch = orient_atan2(-ax, yz, &g);
+    return g >= _acc_lo && g <= _acc_hi;
+}
+
+void Orientation::reset(const int16_t *acc)
+{
+    int32_t roll, pitch;
+
+    _valid = tilt(acc, &roll, &pitch);
+    _roll = roll;
+    _pitch = pitch;
+}
+
+void Orientation::update(const int32_t *gyro, const int16_t *acc)
+{
+    int32_t roll, pitch;
+
+    if (!_valid) {
+        reset(acc);
+        return;
+    }
+    _roll += (uint32_t)((gyro[0] * _gyro_k) >> 16);
+    _pitch += (uint32_t)((gyro[1] * _gyro_k) >> 16);
+    if (!tilt(acc, &roll, &pitch))
+        return;
+    //the difference wraps to the short way round
+    _roll += (uint32_t)(((int64_t)(int32_t)(roll - _roll) * _alpha) >> 15);
+    _pitch += (uint32_t)(((int64_t)(int32_t)(pitch - _pitch) * _alpha) >> 15);
+}
+
+int32_t Orientation::roll()
+{
+    return (int32_t)_roll;
+}
+
+int32_t Orientation::pitch()
+{
+    return (int32_t)_pitch;
+}
@@ -0,0 +1,69 @@
+/**
+* Fixed-point wrist orientation (roll/pitch) for the FPU-less LPC1768
+*
+* Complementary filter: every gyro sample is integrated into the angles,
+* then the angles are pulled towards the tilt seen by the accelerometer
+* by a fraction set by the time constant, so gyro drift is removed while
+* short motions follow the gyro. The accelerometer is ignored while its
+* magnitude is more than ORIENT_ACC_GATE away from 1 g (the hand is
+* being swung, gravity is not the only force).
+*
+* Angles are 32 bit binary angles (Q31 of 180 degrees, 0x80000000 =
+* -180), so they wrap like the real angle and a difference of two angles
+* is always the short way round. atan2 and vector length come from a 16
+* step CORDIC, the sample path is shifts, adds and a few 32x32->64
+* multiplies, no float and no division.
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include "mbed.h"
+
+#define ORIENT_ACC_GATE 25      //percent of 1 g the accelerometer may be off
+#define ORIENT_CORDIC_STEPS 16
+
+/** atan2(y, x) as a binary angle, inputs below 2^29
+ *
+ * @param mag if not NULL, gets sqrt(x*x + y*y)
+ */
+int32_t orient_atan2(int32_t y, int32_t x, int32_t *mag = NULL);
+
+/** binary angle to hundredths of a degree */
+int orient_cdeg(int32_t angle);
+
+class Orientation {
+public:
+    /** Create a filter
+     *
+     * @param sample_us is the gyro sample period
+     * @param gyro_udps is the gyro input scale in micro-dps per LSB
+     * @param acc_1g is the accelerometer input value for 1 g
+     * @param tau_ms is how long the gyro alone is trusted
+     */
+    Orientation(int sample_us, int gyro_udps, int acc_1g, int tau_ms = 500);
+
+    /** start again from the accelerometer tilt */
+    void reset(const int16_t *acc);
+
+    /** one gyro sample (x, y, z) and the accelerometer sample taken with it */
+    void update(const int32_t *gyro, const int16_t *acc);
+
+    /** rotation about x / y as binary angles */
+    int32_t roll();
+    int32_t pitch();
+
+private:
+    bool tilt(const int16_t *acc, int32_t *roll, int32_t *pitch);
+
+    int64_t _gyro_k;    //binary angle per gyro LSB per sample, Q16
+    int32_t _alpha;     //accelerometer weight, Q15
+    int32_t _acc_lo;    //accepted accelerometer magnitude range
+    int32_t _acc_hi;
+    uint32_t _roll;     //unsigned so the angles wrap instead of overflowing
+    uint32_t _pitch;
+    bool _valid;
+};
+
+#endif
@@ -0,0 +1,73 @@
+/**
+* Force grades of a pinch, see PinchForce.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "PinchForce.h"
+
+PinchForce::PinchForce(int light, int medium, int hard, int hysteresis,
+                       int baseline_shift)
+{
+    _edge[0] = light;
+    _edge[1] = medium;
+    _edge[2] = hard;
+    _hysteresis = hysteresis;
+    _shift = baseline_shift;
+    _primed = false;
+    _base = 0;
+    _force = 0;
+    _grade = PINCH_RELEASED;
+    _peak = PINCH_RELEASED;
+}
+
+int PinchForce::sample(int level)
+{
+    int base;
+
+    if (!_primed) {
+        _base = (int32_t)level << _shift;
+        _primed = true;
+    }
+    base = _base >> _shift;
+    _force = level - base;
+    if (_force < 0) {
+        //released level went down, follow it at once
+        _base = (int32_t)level << _shift;
+        base = level;
+        _force = 0;
+    }
+
+    while (_grade < PINCH_HARD && _force >= _edge[_grade])
+        _grade++;
+    while (_grade > PINCH_RELEASED && _force < _edge[_grade - 1] - _hysteresis)
+        _grade--;
+
+    if (_grade == PINCH_RELEASED)
+        _base += level - base;  //(level - base) / 2^shift, in the fraction
+    if (_grade > _peak)
+        _peak = _grade;
+    return _grade;
+}
+
+int PinchForce::grade()
+{
+    return _grade;
+}
+
+int PinchForce::take()
+{
+    int g = _peak;
+
+    _peak = _grade;
+    return g;
+}
+
+int PinchForce::force()
+{
+    return _force;
+}
+
+int PinchForce::baseline()
+{
+    return _base >> _shift;
+}
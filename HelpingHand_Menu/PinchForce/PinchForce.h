@@ -0,0 +1,84 @@
+/**
+* Force grades of a pinch from the analog pressure signal
+*
+* sample() takes one level of the sensor at a time and keeps the grade
+* of the pinch up to date: PINCH_RELEASED, then PINCH_LIGHT, PINCH_MEDIUM
+* or PINCH_HARD once the force above the baseline reaches the light,
+* medium or hard threshold. A grade is left only when the force falls
+* hysteresis counts below its threshold, so noise at an edge does not
+* make the grade flicker.
+*
+* The baseline is the released level. It follows the signal with a
+* first order filter (time constant 2^baseline_shift samples) while the
+* pinch is released, and at once when the signal falls below it, so
+* sensor drift and temperature do not turn into force. It is held while
+* pressed, so a long pinch does not fade away.
+*
+* All integer, O(1) per sample.
+*
+* @code
+* PinchForce right(300, 900, 1800, 100);
+* ...
+* right.sample(level);        //every few ms
+* int g = right.take();       //hardest grade since the last take()
+* @endcode
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef PINCHFORCE_H
+#define PINCHFORCE_H
+
+#include "mbed.h"
+
+//grades
+#define PINCH_RELEASED 0
+#define PINCH_LIGHT 1
+#define PINCH_MEDIUM 2
+#define PINCH_HARD 3
+
+class PinchForce {
+public:
+    /** Create a classifier, thresholds are counts above the baseline
+     *
+     * @param light is where a press starts
+     * @param medium is where a press is medium
+     * @param hard is where a press is hard
+     * @param hysteresis is how far below a threshold the grade drops
+     * @param baseline_shift sets how slowly the baseline follows
+     */
+    PinchForce(int light, int medium, int hard, int hysteresis,
+               int baseline_shift = 9);
+
+    /** next level of the sensor, in time order
+     *
+     * @return the grade now
+     */
+    int sample(int level);
+
+    /** the grade now */
+    int grade();
+
+    /** hardest grade since the last take(), so a short pinch between two
+     * takes is not missed; starts again from the grade now
+     */
+    int take();
+
+    /** force above the baseline at the last sample, in counts */
+    int force();
+
+    /** released level, in counts */
+    int baseline();
+
+private:
+    int _edge[PINCH_HARD];      //thresholds of light, medium, hard
+    int _hysteresis;
+    int _shift;
+
+    bool _primed;               //the baseline has its first sample
+    int32_t _base;              //baseline << _shift
+    int _force;
+    int _grade;
+    int _peak;
+};
+
+#endif
@@ -0,0 +1,58 @@
+/**
+* Table-driven quantizer for raw sensor magnitudes
+*
+* The bin edges are a template argument: an array of N increasing upper
+* edges in thousandths of the sensor unit (mg for the accelerometer).
+* A value above EDGES[i] is at least level i + 1, so there are N + 1
+* levels and the table is free to be uneven or per patient. The edges are
+* turned into a table with one level per 2^SHIFT raw counts when the
+* quantizer is constructed, after that a lookup is a shift and one load.
+* Edges are placed to the nearest 2^SHIFT counts.
+*
+* @code
+* extern const int edges[] = {250, 450, 650};     //mg
+* Quantizer<3, edges, LSM303DLHC_ACC_LSB_PER_G, 5> level;
+* int l = level(raw);     //0 to 3
+* @endcode
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef QUANTIZER_H
+#define QUANTIZER_H
+
+#include "mbed.h"
+
+template <int N, const int (&EDGES)[N], int LSB_PER_UNIT, int SHIFT>
+class Quantizer {
+public:
+    enum {
+        LEVELS = N + 1,
+        SIZE = (32768 >> SHIFT) + 1     //covers the magnitude of any int16
+    };
+
+    Quantizer() {
+        int half = (1 << SHIFT) / 2;
+
+        for (int i = 0; i < SIZE; i++) {
+            //level of the middle of the counts the entry stands for
+            int counts = (i << SHIFT) + half;
+            uint8_t level = 0;
+            while (level < N && counts > EDGES[level] * LSB_PER_UNIT / 1000)
+                level++;
+            _table[i] = level;
+        }
+    }
+
+    /** level of a raw value, the sign is ignored */
+    int operator()(int value) const {
+        if (value < 0)
+            value = -value;
+        value >>= SHIFT;
+        return _table[value < SIZE ? value : SIZE - 1];
+    }
+
+private:
+    uint8_t _table[SIZE];
+};
+
+#endif
@@ -0,0 +1,51 @@
+/**
+* Rotation speed of the hand from the gyro
+*
+* update() takes every gyro sample, with the zero-rate offset already
+* removed (see SensorCal). The length of the rate vector is smoothed
+* with a time constant of tau_ms, so speed() is new after every sample
+* and settles within a few tau of the hand starting or stopping.
+*
+* Integer only: an integer square root and one 32x32->64 multiply per
+* sample.
+*
+* @code
+* RotationSpeed rotation(GYRO_SAMPLE_US, L3GX_UDPS_250DPS);
+* ...
+* rotation.update(w);         //every gyro sample
+* int dps = rotation.mdps() / 1000;
+* @endcode
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef ROTATIONSPEED_H
+#define ROTATIONSPEED_H
+
+#include "mbed.h"
+
+class RotationSpeed {
+public:
+    /** Create an estimator
+     *
+     * @param sample_us is the gyro sample period
+     * @param gyro_udps is the gyro input scale in micro-dps per LSB
+     * @param tau_ms is the smoothing time constant
+     */
+    RotationSpeed(int sample_us, int gyro_udps, int tau_ms = 50);
+
+    /** one gyro sample (x, y, z), raw counts without the bias */
+    void update(const int32_t *gyro);
+
+    /** smoothed rotation speed, in raw gyro counts */
+    int32_t speed();
+
+    /** smoothed rotation speed, in thousandths of a dps */
+    int32_t mdps();
+
+private:
+    int _udps;
+    int32_t _k;                 //smoothing weight, Q15
+    int32_t _speed;             //counts, Q8
+};
+
+#endif
@@ -0,0 +1,102 @@
+/**
+* Cooperative run-to-completion task scheduler
+*
+* Each Task is a function with a relative deadline. It is released
+* periodically (start()), once after a delay (once()) or right away from
+* anywhere, ISRs included (post()). dispatch() runs the ready task with
+* the earliest deadline to completion and returns; with nothing ready it
+* sleeps the CPU (__WFI) until the next release or interrupt, woken by a
+* WheelTicker on the timer wheel. A release that finds the task still
+* waiting to run, or a run that ends after its deadline, counts as a miss.
+*
+* Tasks never preempt each other, so state shared only between tasks
+* needs no locking. Keep each run short: the longest run is the latency
+* every other task may see.
+*
+* @code
+* TimerWheel timers;
+* Scheduler tasks(timers);
+* Task blink(tasks, &toggle, 5000);       //deadline 5 ms after release
+* tasks.start(&blink, 500000);
+* while (true)
+*     tasks.dispatch();
+* @endcode
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "mbed.h"
+#include "TimerWheel.h"
+
+#define SCHED_TASKS 12          //most tasks one scheduler holds
+
+class Scheduler;
+
+class Task {
+public:
+    /** Create a task and add it to sched, it is not released yet
+     *
+     * @param fn runs to completion once per release
+     * @param deadline_us is how long after a release the run must be done
+     */
+    Task(Scheduler &sched, void (*fn)(void), uint32_t deadline_us);
+
+    /** completed runs, missed releases and deadlines, longest run in us */
+    uint32_t runs();
+    uint32_t misses();
+    uint32_t worst_us();
+
+private:
+    friend class Scheduler;
+
+    void (*_fn)(void);
+    uint32_t _deadline_us;
+    uint32_t _period;           //us, 0 - not periodic
+    uint32_t _release;          //next timed release, us_ticker_read() time
+    uint32_t _due;              //deadline of the pending run
+    bool _timed;                //_release is valid
+    bool _ready;
+    volatile bool _posted;      //set by post(), taken by dispatch()
+    uint32_t _runs;
+    uint32_t _misses;
+    uint32_t _worst;
+};
+
+class Scheduler {
+public:
+    /** Create a scheduler
+     *
+     * @param wheel supplies the wake-up timer
+     */
+    Scheduler(TimerWheel &wheel);
+
+    /** release t every period_us, the first time one period from now */
+    void start(Task *t, uint32_t period_us);
+
+    /** release t once, delay_us from now, replaces a start() */
+    void once(Task *t, uint32_t delay_us);
+
+    /** no more timed releases of t, a pending run still happens */
+    void stop(Task *t);
+
+    /** release t now, safe from ISRs */
+    void post(Task *t);
+
+    /** run the most urgent ready task, or sleep until something happens */
+    void dispatch();
+
+private:
+    friend class Task;
+
+    void add(Task *t);
+    void release(Task *t, uint32_t at);
+    bool posted();
+
+    Task *_tasks[SCHED_TASKS];
+    int _count;
+    WheelTicker _wake;
+};
+
+#endif
@@ -0,0 +1,167 @@
+/**
+* Gyro bias and accelerometer offset/scale, learned while the hand is
+* still and kept in flash
+*
+* observe() takes the raw samples of every FIFO drain. They are cut into
+* windows of window_ms; a window is still when the spread (max - min) of
+* every gyro axis stays under still_dps and of every accelerometer axis
+* under still_mg. Each still window refines the calibration:
+*
+* - the window mean goes into the gyro bias bin of the temperature set
+*   with temperature() (a running average, then the last
+*   CAL_BIN_WEIGHT windows), a mean more than CAL_GYRO_JUMP_DPS away
+*   from the bias is taken for slow steady rotation and ignored
+* - the accelerometer window mean widens the highest and lowest reading
+*   seen on each axis; once an axis has seen gravity both ways
+*   (CAL_ACC_SEEN_PERCENT of 1 g) its offset is the middle and its scale
+*   half the distance
+*
+* The gyro zero-rate offset drifts with the die temperature. A straight
+* line bias = a + b * temperature is fitted to the bins (least squares,
+* weighted by the windows in each bin) whenever a bin changes, and the
+* bias applied is the line at the temperature now; temperature() only
+* needs calling every few seconds. With one bin the line is flat. The
+* bins span CAL_TEMP_BINS degrees; a still window outside them shifts
+* them over and the bins at the far end are dropped.
+*
+* correct_gyro() and correct_acc() then remove the offsets in place,
+* a subtract and a multiply per value.
+*
+* load() and save() keep the calibration, tagged with the gyro die
+* temperature, in the last 32 kB sector of the LPC1768 flash, written
+* through IAP. Records are appended one 256 byte page at a time and the
+* sector is only erased when it is full, load() takes the newest valid
+* one, so it is a few memory reads at boot and the glove does not have
+* to be held still first. save() blocks with interrupts off while the
+* flash is written (and erased, every CAL_PAGES saves), call it when
+* nothing is time critical. Off target the sector is a RAM buffer, lost
+* at reset.
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef SENSORCAL_H
+#define SENSORCAL_H
+
+#include "mbed.h"
+
+#define CAL_FLASH_ADDR 0x78000  //LPC1768 sector 29, the last one
+#define CAL_FLASH_SECTOR 29
+#define CAL_FLASH_SIZE 0x8000
+#define CAL_PAGE 256            //smallest IAP write
+#define CAL_PAGES (CAL_FLASH_SIZE / CAL_PAGE)
+#define CAL_GYRO_JUMP_DPS 20    //largest bias change a still window may make
+#define CAL_ACC_SEEN_PERCENT 80 //of 1 g, before an axis counts as calibrated
+#define CAL_SAVE_DPS 1          //bias change that makes the flash copy stale
+#define CAL_TEMP_BINS 24        //gyro bias bins, one per degree C
+#define CAL_TEMP_BELOW 4        //bins below the first temperature seen,
+                                //the bins shift when it is left
+#define CAL_BIN_WEIGHT 8        //still windows a bin averages over
+
+//CalData.valid
+#define CAL_GYRO 0x01
+#define CAL_ACC_X 0x02          //CAL_ACC_X << axis
+
+struct CalData {
+    int16_t gyro_bias[3];       //raw gyro counts
+    int16_t acc_offset[3];      //raw accelerometer counts
+    int16_t acc_scale[3];       //raw accelerometer counts per g
+    int8_t temp;                //gyro OUT_TEMP when the bias was learned
+    uint8_t valid;              //CAL_GYRO, CAL_ACC_X << axis
+    int8_t temp_origin;         //OUT_TEMP of bin CAL_TEMP_BELOW
+    uint8_t bins;               //bins with a weight
+    int16_t bin_bias[CAL_TEMP_BINS][3];     //raw gyro counts, Q2
+    uint8_t bin_weight[CAL_TEMP_BINS];      //still windows, up to CAL_BIN_WEIGHT
+};
+
+class SensorCal {
+public:
+    /** Create a calibration, nothing is valid until load() or still windows
+     *
+     * @param gyro_udps is the gyro input scale in micro-dps per LSB
+     * @param gyro_sample_us is the gyro sample period
+     * @param acc_1g is the accelerometer input value for 1 g
+     * @param window_ms is the length of a still window
+     * @param still_dps is the largest gyro spread in a still window
+     * @param still_mg is the largest accelerometer spread in a still window
+     */
+    SensorCal(int gyro_udps, int gyro_sample_us, int acc_1g, int window_ms = 500,
+              int still_dps = 4, int still_mg = 40);
+
+    /** take the newest stored calibration
+     *
+     * @return false if there is none
+     */
+    bool load();
+
+    /** store the calibration as learned at gyro temperature temp
+     *
+     * @return false if the flash could not be written
+     */
+    bool save(int8_t temp);
+
+    /** the calibration has moved away from the stored one */
+    bool dirty();
+
+    /** gyro OUT_TEMP now (L3GX_GYRO::read_temp()), moves the bias along
+     * the fitted line; the gyro bias is only learned once this has
+     * been called, until then a loaded bias is used as saved
+     */
+    void temperature(int8_t temp);
+
+    /** raw samples of one FIFO drain, n accelerometer and m gyro (x, y, z)
+     * safe from the sampling ISR
+     */
+    void observe(const int16_t *acc, int n, const int16_t *gyr, int m);
+
+    /** remove the calibration from n samples, in place */
+    void correct_gyro(int16_t *gyr, int n);
+    void correct_acc(int16_t *acc, int n);
+
+    /** the calibration now */
+    const CalData &data();
+
+    /** still windows seen so far */
+    uint32_t still_windows();
+
+private:
+    const struct CalRecord *scan();
+    void apply();
+    void fit();
+    void follow_temperature();
+    int bin();
+    void shift_bins(int by);
+    void window_done();
+    void reset_window();
+
+    CalData _cal;
+    int _acc_1g;
+    int32_t _gyro_band;         //still_dps in counts
+    int32_t _gyro_jump;
+    int32_t _gyro_step;         //CAL_SAVE_DPS in counts
+    int32_t _acc_band;
+    int _window;                //gyro samples per window
+
+    int32_t _bias[3];           //counts, Q4, at the temperature now
+    int32_t _fit_a[3];          //bias line, counts Q10 at bin 0
+    int32_t _fit_b[3];          //and counts Q10 per degree
+    int8_t _temp;               //OUT_TEMP now
+    bool _temp_known;           //_temp is a reading, not a guess
+    int32_t _acc_hi[3];         //highest and lowest still window mean
+    int32_t _acc_lo[3];
+    int32_t _acc_gain[3];       //1 g / scale, Q14
+    CalData _stored;            //as last loaded or saved
+    bool _saved;
+    uint32_t _seq;              //of the newest stored record
+    int _page;                  //next free page, CAL_PAGES if full
+    uint32_t _still_windows;
+
+    //current window
+    int _gn;
+    int _an;
+    int32_t _gsum[3];
+    int32_t _asum[3];
+    int16_t _gmin[3], _gmax[3];
+    int16_t _amin[3], _amax[3];
+};
+
+#endif
@@ -0,0 +1,281 @@
+/**
+* Hierarchical timer wheel, see TimerWheel.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "TimerWheel.h"
+
+#define TIMER_MAX_TICKS ((1u << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1)
+
+//lowest set bit of a 32 bit word, de Bruijn multiply, no loop
+static const uint8_t debruijn_bit[32] = {
+    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+    31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+};
+
+/**
+* slots after idx to the first non-empty one, 1 to TIMER_SLOTS
+* (TIMER_SLOTS - the slot at idx itself, one turn later)
+*/
+static uint32_t slot_distance(uint32_t mask, int idx)
+{
+    int s = (idx + 1) & (TIMER_SLOTS - 1);
+    uint32_t r = s ? (mask >> s) | (mask << (TIMER_SLOTS - s)) : mask;
+
+    return debruijn_bit[((r & -r) * 0x077cb531u) >> 27] + 1;
+}
+
+static void list_init(WheelLink *head)
+{
+    head->next = head;
+    head->prev = head;
+}
+
+static void list_add_tail(WheelLink *head, WheelLink *n)
+{
+    n->prev = head->prev;
+    n->next = head;
+    head->prev->next = n;
+    head->prev = n;
+}
+
+WheelTicker::WheelTicker(TimerWheel &wheel) : _wheel(wheel)
+{
+    next = NULL;
+    prev = NULL;
+    _fn = NULL;
+    _expires = 0;
+    _period = 0;
+    _level = -1;
+    _slot = 0;
+}
+
+WheelTicker::~WheelTicker()
+{
+    detach();
+}
+
+void WheelTicker::attach_us(void (*fptr)(void), uint32_t t)
+{
+    _fn = fptr;
+    _wheel.add(this, t, t);
+}
+
+void WheelTicker::once_us(void (*fptr)(void), uint32_t t)
+{
+    _fn = fptr;
+    _wheel.add(this, t, 0);
+}
+
+void WheelTicker::detach()
+{
+    _wheel.remove(this);
+}
+
+TimerWheel::TimerWheel()
+{
+    for (int l = 0; l < TIMER_LEVELS; l++) {
+        for (int s = 0; s < TIMER_SLOTS; s++)
+            list_init(&_slots[l][s]);
+        _mask[l] = 0;
+    }
+    _now = 0;
+    _time = us_ticker_read();
+    _deadline = 0;
+    _armed = false;
+}
+
+void TimerWheel::add(WheelTicker *t, uint32_t delay_us, uint32_t period_us)
+{
+    __disable_irq();
+    unlink(t);
+    uint32_t lag = (us_ticker_read() - _time) / TIMER_TICK_US;
+    bool idle = true;
+    for (int l = 0; l < TIMER_LEVELS; l++)
+        if (_mask[l])
+            idle = false;
+    if (idle) {
+        //nothing can be due, move the wheel to now so the lag stays small
+        _now += lag;
+        _time += lag * TIMER_TICK_US;
+        lag = 0;
+    }
+    uint32_t ticks = (delay_us + TIMER_TICK_US - 1) / TIMER_TICK_US;
+    t->_expires = _now + lag + (ticks ? ticks : 1);
+    t->_period = (period_us + TIMER_TICK_US - 1) / TIMER_TICK_US;
+    if (period_us && !t->_period)
+        t->_period = 1;
+    insert(t);
+    //the wheel has work for t at its expiry on level 0, else when its
+    //slot cascades, the first tick of the slot's span
+    uint32_t due = t->_expires;
+    if (t->_level > 0)
+        due &= ~((1u << (TIMER_SLOT_BITS * t->_level)) - 1);
+    if (!_armed || (int32_t)(due - _deadline) < 0)
+        program(due - _now);
+    __enable_irq();
+}
+
+void TimerWheel::remove(WheelTicker *t)
+{
+    __disable_irq();
+    unlink(t);
+    __enable_irq();
+}
+
+/**
+* puts t in the slot for its expiry tick, relative to the wheel position
+* a timer due at _now itself only comes from a cascade, step() runs it
+*/
+void TimerWheel::insert(WheelTicker *t)
+{
+    uint32_t delta = t->_expires - _now;
+    int l = 0;
+
+    if ((int32_t)delta < 0) {
+        t->_expires = _now;     //late, due at once
+        delta = 0;
+    }
+    if (delta > TIMER_MAX_TICKS) {
+        t->_expires = _now + TIMER_MAX_TICKS;
+        delta = TIMER_MAX_TICKS;
+    }
+    while (l < TIMER_LEVELS - 1 && delta >= 1u << (TIMER_SLOT_BITS * (l + 1)))
+        l++;
+    int s = (t->_expires >> (TIMER_SLOT_BITS * l)) & (TIMER_SLOTS - 1);
+    list_add_tail(&_slots[l][s], t);
+    _mask[l] |= 1u << s;
+    t->_level = l;
+    t->_slot = s;
+}
+
+void TimerWheel::unlink(WheelTicker *t)
+{
+    if (t->next == NULL)
+        return;
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+    if (t->_level >= 0) {
+        WheelLink *head = &_slots[t->_level][t->_slot];
+        if (head->next == head)
+            _mask[t->_level] &= ~(1u << t->_slot);
+    }
+    t->_level = -1;
+}
+
+/**
+* moves the timers of a higher level slot down, they are due within its span
+*/
+void TimerWheel::cascade(int level, int slot)
+{
+    WheelLink *head = &_slots[level][slot];
+
+    while (head->next != head) {
+        WheelTicker *t = static_cast<WheelTicker *>(head->next);
+        unlink(t);
+        insert(t);
+    }
+}
+
+/**
+* runs the timers of a level 0 slot, they are due at tick _now
+*/
+void TimerWheel::expire(int slot)
+{
+    WheelLink *head = &_slots[0][slot];
+    WheelLink due;
+
+    //take the whole slot first, callbacks may arm into it again
+    list_init(&due);
+    while (head->next != head) {
+        WheelTicker *t = static_cast<WheelTicker *>(head->next);
+        unlink(t);
+        list_add_tail(&due, t);
+    }
+    while (due.next != &due) {
+        WheelTicker *t = static_cast<WheelTicker *>(due.next);
+        unlink(t);
+        if (t->_period) {
+            t->_expires += t->_period;
+            insert(t);
+        }
+        if (t->_fn)
+            t->_fn();
+    }
+}
+
+/**
+* the wheel has just moved to tick _now
+* higher levels first, so a timer can move down more than one level
+*/
+void TimerWheel::step()
+{
+    int top = 0;
+
+    while (top < TIMER_LEVELS - 1
+           && (_now & ((1u << (TIMER_SLOT_BITS * (top + 1))) - 1)) == 0)
+        top++;
+    for (int l = top; l > 0; l--)
+        cascade(l, (_now >> (TIMER_SLOT_BITS * l)) & (TIMER_SLOTS - 1));
+    expire(_now & (TIMER_SLOTS - 1));
+}
+
+/**
+* ticks from _now to the next tick with work, 0 if no timer is armed
+*/
+uint32_t TimerWheel::next()
+{
+    uint32_t best = 0;
+
+    for (int l = 0; l < TIMER_LEVELS; l++) {
+        if (!_mask[l])
+            continue;
+        int shift = TIMER_SLOT_BITS * l;
+        uint32_t d = slot_distance(_mask[l], (_now >> shift) & (TIMER_SLOTS - 1));
+        uint32_t ticks = (((_now >> shift) + d) << shift) - _now;
+        if (best == 0 || ticks < best)
+            best = ticks;
+    }
+    return best;
+}
+
+/**
+* sets the hardware timeout ticks after _now, 0 - nothing to wait for
+* a cancelled timer leaves it set, run() then finds nothing and moves on
+*/
+void TimerWheel::program(uint32_t ticks)
+{
+    if (ticks == 0) {
+        _hw.detach();
+        _armed = false;
+        return;
+    }
+    _deadline = _now + ticks;
+    _armed = true;
+    int32_t us = (int32_t)(_time + ticks * TIMER_TICK_US - us_ticker_read());
+    _hw.attach_us(this, &TimerWheel::run, us > 0 ? us : 1);
+}
+
+/**
+* hardware timeout, moves the wheel to now running everything due
+* on the way, empty ticks are skipped
+*/
+void TimerWheel::run()
+{
+    uint32_t ticks = (us_ticker_read() - _time) / TIMER_TICK_US;
+
+    while (ticks > 0) {
+        uint32_t d = next();
+        bool due = d != 0 && d <= ticks;
+        if (!due)
+            d = ticks;
+        _now += d;
+        _time += d * TIMER_TICK_US;
+        ticks -= d;
+        if (due)
+            step();
+    }
+    program(next());
+}
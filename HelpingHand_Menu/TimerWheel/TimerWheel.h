@@ -0,0 +1,107 @@
+/**
+* Hierarchical timer wheel, all software timers on one hardware timeout
+*
+* Every WheelTicker is a node in one of TIMER_LEVELS x TIMER_SLOTS lists.
+* Level 0 has one slot per TIMER_TICK_US tick, each higher level covers
+* TIMER_SLOTS times the span of the one below, so arming and cancelling a
+* timer is a list insert / unlink, whatever the number of timers. When
+* the wheel reaches a higher level slot its timers move down a level.
+*
+* Only one mbed Timeout is used. It is set for the next tick with work,
+* an expiry on level 0 or the cascade of a higher level slot, found from
+* the per-level slot masks without looking at the timers, and moves the
+* wheel over every tick up to then in one go, skipping empty ones.
+* Arming only compares the new timer's tick with the one programmed. There is no periodic tick
+* interrupt and idle time costs nothing. Periodic timers are re-armed from their due tick,
+* so they do not drift. Delays are rounded up to whole ticks, the
+* longest is TIMER_SLOTS^TIMER_LEVELS ticks (17 minutes).
+*
+* The callbacks run in interrupt context, like Ticker callbacks.
+*
+* @code
+* TimerWheel timers;
+* WheelTicker blink(timers);
+* blink.attach_us(&toggle, 500000);
+* @endcode
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "mbed.h"
+
+#define TIMER_TICK_US 1000      //wheel resolution
+#define TIMER_LEVELS 4
+#define TIMER_SLOT_BITS 5
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)   //one bit each in a slot mask
+
+class TimerWheel;
+
+/** list node, the slot heads are bare links */
+struct WheelLink {
+    WheelLink *next;
+    WheelLink *prev;
+};
+
+/** a Ticker / Timeout replacement that lives on a TimerWheel */
+class WheelTicker : public WheelLink {
+public:
+    WheelTicker(TimerWheel &wheel);
+    ~WheelTicker();
+
+    /** call fptr every t seconds */
+    void attach(void (*fptr)(void), float t) {
+        attach_us(fptr, (uint32_t)(t * 1000000.0f));
+    }
+
+    /** call fptr every t us */
+    void attach_us(void (*fptr)(void), uint32_t t);
+
+    /** call fptr once, t us from now */
+    void once_us(void (*fptr)(void), uint32_t t);
+
+    /** stop, safe from any callback */
+    void detach();
+
+private:
+    friend class TimerWheel;
+
+    TimerWheel &_wheel;
+    void (*_fn)(void);
+    uint32_t _expires;          //tick
+    uint32_t _period;           //ticks, 0 - one shot
+    int8_t _level;              //list the node is on, -1 - none or being run
+    uint8_t _slot;
+};
+
+class TimerWheel {
+public:
+    TimerWheel();
+
+    /** arm t to expire delay_us from now, then every period_us if not 0 */
+    void add(WheelTicker *t, uint32_t delay_us, uint32_t period_us);
+
+    /** disarm t, nothing happens if it is not armed */
+    void remove(WheelTicker *t);
+
+private:
+    void insert(WheelTicker *t);
+    void unlink(WheelTicker *t);
+    void cascade(int level, int slot);
+    void expire(int slot);
+    void step();
+    uint32_t next();
+    void program(uint32_t ticks);
+    void run();
+
+    WheelLink _slots[TIMER_LEVELS][TIMER_SLOTS];
+    uint32_t _mask[TIMER_LEVELS];   //bit s set - slot s is not empty
+    uint32_t _now;                  //wheel position, ticks
+    uint32_t _time;                 //us_ticker_read() of tick _now
+    uint32_t _deadline;             //tick _hw is set for
+    bool _armed;                    //_hw is set
+    Timeout _hw;
+};
+
+#endif
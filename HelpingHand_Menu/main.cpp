@@ -16,6 +16,8 @@ int main() {
     buf[1] = 0;
     buf[2] = 0;
     buf[3] = 0;
+    leftForce = 0;
+    rightForce = 0;
     send  = 0;
     /********* XBee init ***********/
     rst1 = 0; //Set reset pin to 0
@@ -25,80 +27,77 @@ int main() {
 
     //vibration motor
     vibrate = 0;
+    //battery and pressure levels from here on
+    analog.start();
     //detect pinch - pressure sensors
-    rightTurn.rise(&turnRight);
-    leftTurn.rise(&turnLeft);
-    turnCountRight = 0;
-    turnCountLeft = 0;
+    //the ISRs only queue timestamped edges, CheckTaps() classifies them
+    rightTurn.rise(&rightPressed);
+    rightTurn.fall(&rightReleased);
+    leftTurn.rise(&leftPressed);
+    leftTurn.fall(&leftReleased);
 
     //acceleration plot
-    x_ax = 0.0;
+    x_ax = 0;
+    rotationRate = 0;
+    //start filling the speed window in the background
+    SetSpeedWindow();
+    accLast[0] = 0; accLast[1] = 0; accLast[2] = 0;
+    gyroLast[0] = 0; gyroLast[1] = 0; gyroLast[2] = 0;
+    wristRoll = 0; wristPitch = 0;
+    motionHead = 0; motionTail = 0; motionLost = 0;
+    telemetryOn = false;
+    //offsets from the last session, refined while the hand is still
+    if(!calibration.load())
+        usb.printf("no stored calibration, learning it\r\n");
+    gyroTemp = 0;
+    ReadTemperature();//queued, done before the first drain
+    axcl.fifo_stream();
+    gyro.fifo_stream(0);
+    draining = false;
+    sampler.attach_us(&SampleAccel, SamplePeriod());
 
     /** detect closed fist **/
     quit = false; start = false; debounce = false;
+    flexStart = 0;
     battery_flag = '1';//initialize, battery is good
     flex.rise(&flexed);   // attach the address of the toggle
     flex.fall(&unflexed);
-    //check battery level every 10 seconds
-    timerBattery.attach(&CheckBattery,10.0);
 
     usb.printf("starting transmission!\r\n");
-    xbee1.baud(9600);
-
-
-    while(!quit){
-
-        isGameOver();
-
-        /************** Menu ********************/
-        playGame = false; plotData = false;
-        usb.printf("waiting for user to choose an option..\r\n");
-        //wait till user chooses an option
-        //wait till hub sends ack for chosen option
-//        usb.printf("waiting for ACK from Hub..\r\n");
-        while(!xbee1.readable());
-//        usb.printf("received something..\r\n");
-        if(xbee1.readable()){
-            int8_t received = xbee1.getc();
-            if(received == 0) //option 1 = play game, changed from 1 to 0
-                playGame = true;
-            else if(received == 2) //no change
-                plotData = true;
-            else if (received == 4)//quit changed from 15 to 4
-                quit = true;
-//            usb.printf("implementing correct option: %d\r\n", received);
-        }
+    xbee1.baud(XBEE_BAUD);
+
+    hubInbox.on(HUB_PLAY, &HubPlay);
+    hubInbox.on(HUB_COLLISION, &HubCollision);
+    hubInbox.on(HUB_PLOT, &HubPlot);
+    hubInbox.on(HUB_EXIT, &HubExit);
+    tasks.start(&inputTask, INPUT_PERIOD_US);
+    //check battery level every 10 seconds
+    tasks.start(&batteryTask, BATTERY_PERIOD_US);
+    tasks.start(&calTask, CAL_SAVE_PERIOD_US);
+    tasks.start(&tempTask, TEMP_PERIOD_US);
+
+    /************** Menu ********************/
+    playGame = false; plotData = false;
+    usb.printf("waiting for user to choose an option..\r\n");
+    //the hub picks the mode, its handlers start and stop the tasks;
+    //the CPU sleeps whenever no task is ready
+    while(!quit)
+        tasks.dispatch();
+    SaveCalibration();
+}
 
-        while(playGame){
-            if(xbee1.readable())
-                backToMenu();
-            CheckSpeed();
-            //DisplayLED();
-            /********************sending data***********************/
-            decode();
-            xbee1.putc(send);
-            wait_ms(10);
-            xbee1.putc('\n');
-            wait_ms(10);
-            wait_ms(500);
-        }//play game
-
-//        usb.printf("plotting data\r\n");
-        while(plotData){
-
-            CheckSpeed();
-            float l = leftData.read()*100;
-            xbee1.putc(l);
-            xbee1.putc(' ');
-            float r = rightData.read()*100;
-            xbee1.putc(r);
-            xbee1.putc(' ');
-            xbee1.putc(x_ax);
-            xbee1.putc('\n');
-//            usb.printf("L: %f; R: %f Ac: %f\r\n",l,r,x_ax);
-            wait_ms(500);
-        }//plot data
-    }//quit
+/**
+* game mode task, every COMMAND_PERIOD_MS
+* sends the command for one game move
+*/
+void GameCommand(){
+
+    CheckSpeed();
+    CheckTaps();
+    //DisplayLED();
+    /********************sending data***********************/
+    decode();
+    SendCommand();
 }
 
 /**
@@ -121,7 +120,8 @@ void decode(){
     left = ~0 - ((1<< SPEED_MSB) - 1);
     right = ((1<< SPEED_LSB) - 1);
     mask = left | right;
-    send = (send & mask) | (buf[1] << SPEED_LSB );
+    int speed = buf[1] > 7 ? 7 : buf[1];//3 bits, the frame has the full level
+    send = (send & mask) | (speed << SPEED_LSB );
 
 //    //bit 1 - buf[2]
     if(buf[2] > 0) { //pressed
@@ -135,159 +135,493 @@ void decode(){
 }
 
 /**
-* derives speed of hand rotation from accelerometer readings
+* sends the command byte and the values it was made from in one frame
+* payload: command, motion, speed level, left taps, right taps,
+* battery, |x| acceleration average in mg, wrist roll and pitch in
+* hundredths of a degree (int16 each), left and right pinch force
+* (PINCH_RELEASED to PINCH_HARD), rotation speed in 0.1 dps (int16)
+* queued without waiting, dropped (and counted) if the radio is backed up
+*/
+void SendCommand(){
+
+    hubLink.begin(FRAME_COMMAND);
+    hubLink.put_u8(send);
+    hubLink.put_u8(buf[0]);
+    hubLink.put_u8(buf[1]);
+    hubLink.put_u8(buf[2]);
+    hubLink.put_u8(buf[3]);
+    hubLink.put_u8(battery_flag == '1');
+    hubLink.put_i16(x_ax);
+    hubLink.put_i16(wristRoll);
+    hubLink.put_i16(wristPitch);
+    hubLink.put_u8(leftForce);
+    hubLink.put_u8(rightForce);
+    hubLink.put_i16(rotationRate);
+    hubLink.send();
+}
+
+/**
+* speed level of hand rotation, from the gyro rotation speed FuseMotion()
+* keeps up to date, blended with SPEED_ACC_BLEND of the |x| acceleration
+* average of the last SPEED_WINDOW_MS of samples drained by GyroDrained()
 */
 void CheckSpeed(){
 
-    int speed;
-    int num_data = 10;
-    float ax_raw_avg = 0.0;
-    float x_temp;
-    float z_temp;
-
-    //detecing speed
-    for (int j=0;j<num_data;j++) {
-        axcl.read_xz(&x_temp,&z_temp);
-        wait_ms(10);
-        ax_raw_avg = ax_raw_avg + abs(x_temp);
+    int rate;
+    int ax_raw_avg;
+
+    __disable_irq();//sum and length change together at a rate change
+    ax_raw_avg = speedSum / speedLen;
+    __enable_irq();
+    x_ax = ax_raw_avg * 1000 / axcl.scale();
+    rate = rotation.speed();
+    rotationRate = rotation.mdps() / 100;
+    if(SPEED_ACC_BLEND > 0){
+        int acc = ax_raw_avg * SPEED_DPS_PER_G * GYRO_LSB_PER_DPS / axcl.scale();
+        rate = (rate * (256 - SPEED_ACC_BLEND) + acc * SPEED_ACC_BLEND) / 256;
     }
-    ax_raw_avg = ax_raw_avg / num_data;
-    x_ax = ax_raw_avg*100;
-    speed = GearBox_ax(ax_raw_avg);
-    buf[1] = speed;
+    buf[1] = gearBox(rate);
 }
 
 /**
-* maps speed of rotation to a value 1 through 5
+* |x| window for the accelerometer rate set, about SPEED_WINDOW_MS long
+* whatever the rate (one sample at 10 Hz), emptied to start over
 */
-int GearBox_ax(float speed) {
-    if (speed <= 0.25) {
-        return 0;
-    } else if (speed > 0.25 && speed <= 0.45) {
-        return 1;
-    } else if (speed > 0.45 && speed <= 0.65) {
-        return 2;
-    } else if (speed > 0.65 && speed <= 0.85) {
-        return 3;
-    } else if (speed > 0.85 && speed <= 1.05) {
-        return 4;
-    } else {
-        return 5;
-    }
+void SetSpeedWindow(){
+
+    uint32_t period = axcl.period_us();
+    int len = period ? SPEED_WINDOW_MS * 1000 / period : 1;
+
+    if(len < 1)
+        len = 1;
+    if(len > SPEED_WINDOW)
+        len = SPEED_WINDOW;
+    __disable_irq();
+    for (int i = 0; i < SPEED_WINDOW; i++)
+        speedWindow[i] = 0;
+    speedHead = 0;
+    speedSum = 0;
+    speedLen = len;
+    __enable_irq();
 }
 
 /**
-* called when user taps his index finger
-* records the tap count
-* resets count to 0 if count reaches 5 or interval is over
+* FIFO drain period for the accelerometer rate set: ACC_PER_DRAIN new
+* samples each time, so no drain reads the FIFOs for nothing, but never
+* so late that the gyro FIFO (GYRO_SAMPLE_US) could overflow
 */
-void turnRight(){
+uint32_t SamplePeriod(){
 
-    if(turnCountRight == 0){
-        timerRight.attach(&overflowRight, 5); //start timer
-    }
-     if(turnCountRight == 5){
-        timerRight.detach(); //stop timer
-        timerRight.attach(&overflowRight, 5); //start timer
-        //reset the count after 90 deg turn
-        turnCountRight = 0;
+    uint32_t period = axcl.period_us() * ACC_PER_DRAIN;
+    uint32_t most = GYRO_SAMPLE_US * (L3GX_FIFO_DEPTH - GYRO_FIFO_MARGIN);
+
+    if(period == 0 || period > most)
+        period = most;
+    return period;
+}
+
+/**
+* called every SamplePeriod() by the sampler ticker
+* queues the accelerometer FIFO drain and returns, the bus runs it from
+* its interrupt; a tick that comes while the last drain is still running
+* is skipped, the samples wait in the FIFOs for the next one
+*/
+void SampleAccel(){
+
+    if(draining)
+        return;
+    draining = true;
+    if(!axcl.read_fifo_async(drainAcc, LSM303DLHC_FIFO_DEPTH, &AccelDrained))
+        draining = false;
+}
+
+/**
+* accelerometer FIFO drained, from the bus interrupt
+* queues the gyro FIFO drain behind it
+*/
+void AccelDrained(int n){
+
+    drainAccN = n;
+    if(!gyro.read_fifo_async(drainGyr, L3GX_FIFO_DEPTH, &GyroDrained))
+        draining = false;
+}
+
+/**
+* both FIFOs drained, from the bus interrupt
+* refines and applies the calibration and queues the samples for the
+* orientation filter, each accelerometer sample replaces the oldest one
+* in the speed window and updates the running sum
+*/
+void GyroDrained(int m){
+
+    int16_t *acc = drainAcc;
+    int16_t *gyr = drainGyr;
+    int n = drainAccN;
+
+    calibration.observe(acc, n, gyr, m);
+    calibration.correct_acc(acc, n);
+    calibration.correct_gyro(gyr, m);
+
+    QueueMotion(acc, n, gyr, m);
+    if(m > 0)
+        tasks.post(&fuseTask);
+
+    for (int j = 0; j < n; j++) {
+        int v = abs(acc[j * 3]);
+        accLast[0] = acc[j * 3];
+        accLast[1] = acc[j * 3 + 1];
+        accLast[2] = acc[j * 3 + 2];
+        //integer sum, exact, so it never needs recomputing
+        speedSum = speedSum - speedWindow[speedHead] + v;
+        speedWindow[speedHead] = v;
+        speedHead++;
+        if(speedHead >= speedLen)
+            speedHead = 0;
     }
-    turnCountRight++;
-    buf[3] = turnCountRight;
+    if(telemetryOn)
+        SampleTelemetry();
+    draining = false;
 }
 
 /**
-* called when user taps his index finger
-* records the tap count
-* resets count to 0 if count reaches 5 or interval is over
+* called by GyroDrained() after each FIFO drain
+* queues each gyro sample for FuseMotion(); the accelerometer runs at a
+* lower rate, each gyro sample is paired with the accelerometer sample
+* taken at about the same time
 */
-void turnLeft(){
+void QueueMotion(const int16_t *acc, int n, const int16_t *gyr, int m){
+
+    int head = motionHead;
 
-    if(turnCountLeft == 0){
-        timerLeft.attach(&overflowLeft, 5); //start timer
+    for (int k = 0; k < m; k++) {
+        int next = (head + 1) & (MOTION_BUFFER - 1);
+        if(next == motionTail){
+            motionLost += m - k;
+            break;
+        }
+        const int16_t *g = &gyr[k * 3];
+        const int16_t *a = n > 0 ? &acc[(k * n / m) * 3] : accLast;
+        Motion *s = &motionBuf[head];
+        for (int i = 0; i < 3; i++) {
+            s->g[i] = g[i];
+            s->a[i] = a[i];
+        }
+        head = next;
     }
-     if(turnCountLeft == 5){
-        timerLeft.detach(); //stop timer
-        timerLeft.attach(&overflowLeft, 5); //start timer
-        //reset the count after 90 deg turn
-        turnCountLeft = 0;
+    motionHead = head;//publish after the slots are written
+    if(m > 0){
+        gyroLast[0] = gyr[(m - 1) * 3];
+        gyroLast[1] = gyr[(m - 1) * 3 + 1];
+        gyroLast[2] = gyr[(m - 1) * 3 + 2];
     }
-    turnCountLeft++;
-    buf[2] = turnCountLeft;
 }
 
 /**
-* called when middle finger pinch time interval is over
-* resets tap count to 0
+* fusion task, posted by GyroDrained()
+* runs the orientation filter and the rotation speed once per queued
+* gyro sample
 */
-void overflowRight(){
+void FuseMotion(){
+
+    int32_t w[3];
+    int tail = motionTail;
+
+    while(tail != motionHead){
+        const Motion *s = &motionBuf[tail];
+        w[0] = s->g[0];
+        w[1] = s->g[1];
+        w[2] = s->g[2];
+        wrist.update(w, s->a);
+        rotation.update(w);
+        tail = (tail + 1) & (MOTION_BUFFER - 1);
+    }
+    motionTail = tail;//free the slots
+    wristRoll = orient_cdeg(wrist.roll());
+    wristPitch = orient_cdeg(wrist.pitch());
+}
 
-    timerRight.detach(); //stop timer
-    turnCountRight = 0;
-    buf[3] = 0;
+/**
+* starts sampling every sensor at TELEMETRY_RATE_HZ for plot mode
+* the accelerometer runs at ACC_PLOT_RATE and the FIFOs are drained at
+* TELEMETRY_RATE_HZ, so each sample has new data
+*/
+void StartTelemetry(){
+
+    telemetryHead = 0;
+    telemetryTail = 0;
+    telemetryCount = 0;
+    telemetryLost = 0;
+    axcl.configure(ACC_PLOT_RATE, ACC_FULL_SCALE, LSM303DLHC_NORMAL);
+    SetSpeedWindow();
+    telemetryOn = true;
+    sampler.attach_us(&SampleAccel, TELEMETRY_PERIOD_US);
+}
+
+void StopTelemetry(){
+
+    telemetryOn = false;
+    axcl.configure(ACC_DATA_RATE, ACC_FULL_SCALE, LSM303DLHC_NORMAL);
+    SetSpeedWindow();
+    sampler.attach_us(&SampleAccel, SamplePeriod());
 }
 
 /**
-* called when index finger pinch time interval is over
-* resets tap count to 0
+* called after each FIFO drain while plotting
+* queues one sample of all channels, counts it as lost if the radio
+* has fallen TELEMETRY_BUFFER samples behind
 */
-void overflowLeft(){
+void SampleTelemetry(){
 
-    timerLeft.detach(); //stop timer
-    turnCountLeft = 0;
-    buf[2] = 0;
+    int head = telemetryHead;
+    int next = (head + 1) & (TELEMETRY_BUFFER - 1);
+    uint16_t n = telemetryCount++;
+
+    if(next == telemetryTail){
+        telemetryLost++;
+        return;
+    }
+    Telemetry *s = &telemetryBuf[head];
+    s->n = n;
+    for (int i = 0; i < 3; i++) {
+        s->v[i] = accLast[i] * 1000 / axcl.scale();
+        s->v[i + 3] = (int64_t)gyroLast[i] * gyro.scale() / 100000;//>2^31 at 2000 dps
+    }
+    s->v[6] = analog.read_u16(leftData) >> 4;
+    s->v[7] = analog.read_u16(rightData) >> 4;
+    telemetryHead = next;//publish after the slot is written
+    if(((next - telemetryTail) & (TELEMETRY_BUFFER - 1)) >= TELEMETRY_BATCH)
+        tasks.post(&telemetryTask);
 }
 
 /**
-* called when user flexes his index hand
-* takes care of debouncing
+* plot mode task, posted by SampleTelemetry() once a batch is queued
 */
-void flexed() {
+void FlushTelemetry(){
 
-    if(!start){
-        flexInterval.start();
-        start = true;
-        buf[0] = 1;//backward
-        debounce = false;
+    while(SendTelemetry())
+        ;
+}
+
+/**
+* sends the queued samples once TELEMETRY_BATCH are waiting
+* payload: first sample number, sample period in us (uint16 each), then
+* per sample a mask byte and TELEMETRY_CHANNELS fields; bit i of the mask
+* set means field i is an int16, otherwise an int8 difference to the
+* previous sample of the frame. A frame ends early at a lost sample.
+* while the radio queue cannot take a full frame the samples stay
+* queued, the next SampleTelemetry() posts the task again
+* returns the number of samples sent
+*/
+int SendTelemetry(){
+
+    int tail = telemetryTail;
+    int sent = 0;
+    Telemetry *prev = NULL;
+
+    if(((telemetryHead - tail) & (TELEMETRY_BUFFER - 1)) < TELEMETRY_BATCH)
+        return 0;
+    if(hubLink.tx_free() < FRAME_MAX)
+        return 0;
+    hubLink.begin(FRAME_TELEMETRY);
+    hubLink.put_u16(telemetryBuf[tail].n);
+    hubLink.put_u16(TELEMETRY_PERIOD_US);
+    while(tail != telemetryHead){
+        Telemetry *s = &telemetryBuf[tail];
+        uint8_t mask = 0xff;
+        int size = 1;
+        if(prev != NULL && (uint16_t)(prev->n + 1) != s->n)
+            break;
+        if(prev != NULL && TELEMETRY_DELTA){
+            mask = 0;
+            for (int i = 0; i < TELEMETRY_CHANNELS; i++) {
+                int d = s->v[i] - prev->v[i];
+                if(d < -128 || d > 127)
+                    mask |= 1 << i;
+            }
+        }
+        for (int i = 0; i < TELEMETRY_CHANNELS; i++)
+            size += (mask & (1 << i)) ? 2 : 1;
+        if(size > hubLink.space())
+            break;
+        hubLink.put_u8(mask);
+        for (int i = 0; i < TELEMETRY_CHANNELS; i++) {
+            if(mask & (1 << i))
+                hubLink.put_i16(s->v[i]);
+            else
+                hubLink.put_u8(s->v[i] - prev->v[i]);
+        }
+        prev = s;
+        tail = (tail + 1) & (TELEMETRY_BUFFER - 1);
+        sent++;
     }
-    else{
-        if(flexInterval.read_ms() > 50)  {//valid flex
-            flexInterval.stop();
-            flexInterval.reset();
-            start = false;
-            debounce = true;
+    telemetryTail = tail;//free the slots
+    hubLink.send();
+    return sent;
+}
+
+/**
+* input task, every INPUT_PERIOD_US
+* applies the events queued by the ISRs, oldest first
+* all state the ISRs used to write is now written here, in the main loop
+*/
+void DispatchEvents(){
+
+    Event ev[EVENT_BATCH];
+    int n;
+
+    while((n = inputEvents.pop(ev, EVENT_BATCH)) > 0){
+        for (int i = 0; i < n; i++) {
+            switch (ev[i].type) {
+                case EV_PINCH_RIGHT:
+                    rightTaps.edge(ev[i].arg, ev[i].t);
+                    break;
+                case EV_PINCH_LEFT:
+                    leftTaps.edge(ev[i].arg, ev[i].t);
+                    break;
+                case EV_FLEX:
+                    FlexEdge(ev[i].arg, ev[i].t);
+                    break;
+            }
         }
     }
 }
 
+/**
+* pressure sensor ISRs, queue the edge for the tap recognizer
+*/
+void rightPressed(){ inputEvents.push(EV_PINCH_RIGHT, 1); }
+void rightReleased(){ inputEvents.push(EV_PINCH_RIGHT, 0); }
+void leftPressed(){ inputEvents.push(EV_PINCH_LEFT, 1); }
+void leftReleased(){ inputEvents.push(EV_PINCH_LEFT, 0); }
+
+/**
+* reads the pinch gestures into the turn fields of the next command,
+* and the hardest pinch of each hand since the last one
+*/
+void CheckTaps(){
+
+    buf[2] = TapTurn(leftTaps);
+    buf[3] = TapTurn(rightTaps);
+    leftForce = leftPinch.take();
+    rightForce = rightPinch.take();
+}
+
+/**
+* turn field for one pinch: the count of the newest tap in its series
+* (1 to TAP_MAX) if there was a tap since the last command, 1 while the
+* pinch is held, else 0
+*/
+int TapTurn(TapGesture &taps){
+
+    int turn = 0;
+    int g;
+
+    while((g = taps.poll()) != GESTURE_NONE){
+        if(g == GESTURE_TAP)
+            turn = taps.count();
+    }
+    if(taps.holding())
+        turn = 1;
+    return turn;
+}
+
+/**
+* pinch task, every PINCH_PERIOD_US while playing
+* grades both pinches from the pressure levels the ADC scans
+*/
+void SamplePinch(){
+
+    leftPinch.sample(analog.read_u16(leftData) >> 4);
+    rightPinch.sample(analog.read_u16(rightData) >> 4);
+}
+
+/**
+* called when user flexes his index hand
+* queues the edge, FlexEdge() debounces it
+*/
+void flexed() {
+    inputEvents.push(EV_FLEX, 1);
+}
+
 /**
 * called when user unflexes his index hand
-* takes care of debouncing
+* queues the edge, FlexEdge() debounces it
 */
 void unflexed() {
-    int t= flexInterval.read_ms();
-    if(start && !debounce && t > 80) { //valid unflex
+    inputEvents.push(EV_FLEX, 0);
+}
+
+/**
+* a flex sensor edge at time t, from DispatchEvents()
+* takes care of debouncing
+*/
+void FlexEdge(int level, uint32_t t) {
+
+    if(level){
+        if(!start){
+            flexStart = t;
+            start = true;
+            buf[0] = 1;//backward
+            debounce = false;
+        }
+        else if(t - flexStart > FLEX_HOLD_US){//valid flex
+            start = false;
+            debounce = true;
+        }
+    }
+    else if(start && !debounce && t - flexStart > FLEX_RELEASE_US){//valid unflex
         buf[0] = 0;//forward
-        flexInterval.stop();
-        flexInterval.reset();
         start = false;
         debounce = false;
-        unflexInterval.start();
     }
-
 }
 
 /**
-* called once per iteration of loop
+* battery task, every BATTERY_PERIOD_US
 * checks if battery voltage is below threshold value
 * if yes, sets a flag to indicate so
 */
 void CheckBattery() {
-    if (ain <= 0.54) {//battery is low, voltage <= 3.6V
+    if (analog.read(batteryLevel) <= 0.54) {//battery is low, voltage <= 3.6V
         battery_flag = '0';
     }
 }
 
+/**
+* calibration task, every CAL_SAVE_PERIOD_US, and at quit
+* writes the calibration to flash if it has moved; only from the menu,
+* interrupts are off while the flash is written
+*/
+void SaveCalibration(){
+
+    if(playGame || plotData || !calibration.dirty())
+        return;
+    if(!calibration.save(gyroTemp))
+        usb.printf("calibration not saved\r\n");
+}
+
+/**
+* temperature task, every TEMP_PERIOD_US
+* queues one register read, TemperatureRead() gets the result
+*/
+void ReadTemperature(){
+
+    gyro.read_temp_async(&TemperatureRead);
+}
+
+/**
+* gyro temperature read, from the bus interrupt like the FIFO drains
+* the gyro bias follows its temperature fit, a failed read keeps the
+* last temperature
+*/
+void TemperatureRead(int8_t t){
+
+    if(t == L3GX_TEMP_NONE)
+        return;
+    gyroTemp = t;
+    calibration.temperature(t);
+}
+
 /**
 * debug
 */
@@ -319,44 +653,95 @@ void DisplayLED() {
 }
 
 /**
-* called once per iteration of loop
-* processes message received from Hub
-* decides state of the game
+* called by the hub RX interrupt after bytes arrived
 */
-void backToMenu(){
+void HubReceived(){
 
-        int8_t received = xbee1.getc();
-        if(received == 4){
-            playGame = false; plotData = false;
-        }
-        else if(received == 1){//collision
-            received = 0;
-            vibrate = 1;
-            vibrateInterval.attach(&vibration, 1.0);
-        }
+    tasks.post(&hubTask);
 }
 
 /**
-* called once per loop
-* processes message received from Hub
-* decides state of the game
+* hub task, posted by HubReceived()
+* hands each message received from Hub to its handler
 */
-void isGameOver(){
+void HubDispatch(){
 
-    if(xbee1.readable()){
-        int8_t received = xbee1.getc();
-        if(received == 3){
-            quit = false; playGame = false; plotData = false;
-        }
+    hubInbox.dispatch();
+}
+
+/**
+* hub chose play game in the menu
+*/
+void HubPlay(uint8_t){
+
+    if(playGame || plotData)
+        return;
+    playGame = true;
+    tasks.start(&pinchTask, PINCH_PERIOD_US);
+    tasks.start(&commandTask, COMMAND_PERIOD_MS * 1000);
+    tasks.post(&commandTask);//first move right away
+}
+
+/**
+* hub chose plot mode in the menu
+*/
+void HubPlot(uint8_t){
+
+    if(playGame || plotData)
+        return;
+    plotData = true;
+    StartTelemetry();
+}
+
+/**
+* player collided in the game
+*/
+void HubCollision(uint8_t){
+
+    if(playGame || plotData)
+        Vibrate();
+}
+
+/**
+* hub left the running mode, or quit from the menu
+*/
+void HubExit(uint8_t){
+
+    if(playGame || plotData)
+        backToMenu();
+    else
+        quit = true;
+}
+
+/**
+* stops the running mode
+*/
+void backToMenu(){
+
+    if(playGame){
+        tasks.stop(&commandTask);
+        tasks.stop(&pinchTask);
     }
+    if(plotData)
+        StopTelemetry();
+    playGame = false; plotData = false;
+    usb.printf("waiting for user to choose an option..\r\n");
+}
+
+/**
+* starts a HAPTIC_PULSE_US vibration
+*/
+void Vibrate(){
+
+    vibrate = 1;
+    tasks.once(&hapticTask, HAPTIC_PULSE_US);
 }
 
 /**
-* called when after 1 s vibration interval ends
-* stops the ticker and vibration motor
+* haptic task, when the vibration pulse ends
+* stops the vibration motor
 */
 void vibration(){
 
-    vibrateInterval.detach();
     vibrate = 0;
 }
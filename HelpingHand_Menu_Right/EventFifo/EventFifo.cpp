@@ -0,0 +1,47 @@
+/**
+* Lock-free ISR to main loop event queue, see EventFifo.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "EventFifo.h"
+
+EventFifo::EventFifo()
+{
+    _head = 0;
+    _tail = 0;
+    _lost = 0;
+}
+
+void EventFifo::push(uint8_t type, uint8_t arg)
+{
+    int head = _head;
+    int next = (head + 1) & (EVENT_FIFO_SIZE - 1);
+
+    if (next == _tail) {
+        _lost++;
+        return;
+    }
+    _ev[head].t = us_ticker_read();
+    _ev[head].type = type;
+    _ev[head].arg = arg;
+    _head = next;   //publish after the slot is written
+}
+
+int EventFifo::pop(Event *ev, int max)
+{
+    int tail = _tail;
+    int head = _head;
+    int n = 0;
+
+    while (tail != head && n < max) {
+        ev[n++] = _ev[tail];
+        tail = (tail + 1) & (EVENT_FIFO_SIZE - 1);
+    }
+    _tail = tail;   //free the slots after they were copied
+    return n;
+}
+
+uint32_t EventFifo::lost()
+{
+    return _lost;
+}
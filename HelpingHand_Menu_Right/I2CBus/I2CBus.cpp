@@ -0,0 +1,277 @@
+/**
+* Shared I2C bus manager, see I2CBus.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "I2CBus.h"
+
+#if defined(TARGET_LPC1768)
+//I2CONSET / I2CONCLR bits
+#define I2C_AA  0x04
+#define I2C_SI  0x08
+#define I2C_STO 0x10
+#define I2C_STA 0x20
+#endif
+
+I2CBus *I2CBus::_instance = NULL;
+
+I2CBus::I2CBus(PinName sda, PinName scl):
+    _i2c(sda, scl)
+{
+    for (int i = 0; i < I2CBUS_MAX_DEVICES; i++) {
+        _addr[i] = -1;
+        _hz[i] = 100000;
+    }
+    _i2c.frequency(100000);
+    _current_hz = 100000;
+    _head = NULL;
+    _tail = NULL;
+    _tx_index = 0;
+    _rx_index = 0;
+    _irq_mode = false;
+#if defined(TARGET_LPC1768)
+    //mbed's I2C has set up pins, power and clock of I2C2,
+    //from here on the state machine below drives it
+    if (sda == p28 && _instance == NULL) {
+        _instance = this;
+        _irq_mode = true;
+        NVIC_SetVector(I2C2_IRQn, (uint32_t)&I2CBus::irq);
+        NVIC_EnableIRQ(I2C2_IRQn);
+    }
+#endif
+}
+
+void I2CBus::frequency(int address, int hz)
+{
+    address &= ~1;
+    for (int i = 0; i < I2CBUS_MAX_DEVICES; i++) {
+        if (_addr[i] == address || _addr[i] == -1) {
+            _addr[i] = address;
+            _hz[i] = hz;
+            return;
+        }
+    }
+}
+
+void I2CBus::apply_frequency(int address)
+{
+    int hz = 100000;
+
+    address &= ~1;
+    for (int i = 0; i < I2CBUS_MAX_DEVICES && _addr[i] != -1; i++) {
+        if (_addr[i] == address) {
+            hz = _hz[i];
+            break;
+        }
+    }
+    if (hz == _current_hz)
+        return;
+#if defined(TARGET_LPC1768)
+    if (_irq_mode) {
+        //let the previous STOP go out at the old rate
+        while (LPC_I2C2->I2CONSET & I2C_STO);
+    }
+#endif
+    _i2c.frequency(hz);
+    _current_hz = hz;
+}
+
+bool I2CBus::transfer(I2CTransfer *t)
+{
+    if (t->result == 1)
+        return false;
+    t->result = 1;
+    t->next = NULL;
+
+    //the START goes out before interrupts come back, otherwise a blocking
+    //transfer() from an ISR in between would queue behind t and wait
+    //for an SI that never comes
+    __disable_irq();
+    if (_tail)
+        _tail->next = t;
+    else
+        _head = t;
+    _tail = t;
+    if (_head == t)
+        start_next();
+    __enable_irq();
+    return true;
+}
+
+int I2CBus::transfer(int address, const char *tx, int tx_length, char *rx, int rx_length)
+{
+    I2CTransfer t;
+
+    t.address = address;
+    t.tx = tx;
+    t.tx_length = tx_length;
+    t.rx = rx;
+    t.rx_length = rx_length;
+    t.done = NULL;
+    t.context = NULL;
+    t.result = 0;
+    transfer(&t);
+
+#if defined(TARGET_LPC1768)
+    if (_irq_mode) {
+        //step the state machine here, so this also works with interrupts
+        //masked or from an ISR that outranks the I2C interrupt
+        NVIC_DisableIRQ(I2C2_IRQn);
+        while (t.result == 1) {
+            if (LPC_I2C2->I2CONSET & I2C_SI)
+                step();
+        }
+        NVIC_EnableIRQ(I2C2_IRQn);
+        return t.result;
+    }
+#endif
+    while (t.result == 1)
+        step();
+    return t.result;
+}
+
+bool I2CBus::busy()
+{
+    return _head != NULL;
+}
+
+void I2CBus::start_next()
+{
+    I2CTransfer *t = _head;
+
+    if (t == NULL)
+        return;
+    apply_frequency(t->address);
+    _tx_index = 0;
+    _rx_index = 0;
+#if defined(TARGET_LPC1768)
+    if (_irq_mode) {
+        //if a STOP is still pending the START follows it
+        LPC_I2C2->I2CONSET = I2C_STA;
+        return;
+    }
+#endif
+    _kick.attach_us(this, &I2CBus::step, 0);
+}
+
+/**
+* called once the running transfer has ended
+* starts the next one before handing the finished one back, so the done
+* callback may queue (or even wait for) more transfers
+*/
+void I2CBus::finish(int result)
+{
+    I2CTransfer *t = _head;
+
+    _head = t->next;
+    if (_head == NULL)
+        _tail = NULL;
+    t->result = result;
+    if (_head)
+        start_next();
+    if (t->done)
+        t->done(t);
+}
+
+#if defined(TARGET_LPC1768)
+/**
+* master transmitter/receiver state machine, one call per SI
+* status codes are from the LPC17xx user manual, table 399/400
+*/
+void I2CBus::step()
+{
+    I2CTransfer *t = _head;
+    int stat = LPC_I2C2->I2STAT;
+
+    if (t == NULL) {
+        LPC_I2C2->I2CONCLR = I2C_SI;
+        return;
+    }
+    switch (stat) {
+        case 0x08: //START sent
+        case 0x10: //repeated START sent
+            if (_tx_index < t->tx_length)
+                LPC_I2C2->I2DAT = t->address & ~1;
+            else
+                LPC_I2C2->I2DAT = t->address | 1;
+            LPC_I2C2->I2CONCLR = I2C_STA | I2C_SI;
+            break;
+        case 0x18: //SLA+W ACKed
+        case 0x28: //data byte ACKed
+            if (_tx_index < t->tx_length) {
+                LPC_I2C2->I2DAT = t->tx[_tx_index++];
+                LPC_I2C2->I2CONCLR = I2C_SI;
+            } else if (t->rx_length > 0) {
+                LPC_I2C2->I2CONSET = I2C_STA;
+                LPC_I2C2->I2CONCLR = I2C_SI;
+            } else {
+                LPC_I2C2->I2CONSET = I2C_STO;
+                LPC_I2C2->I2CONCLR = I2C_SI;
+                finish(0);
+            }
+            break;
+        case 0x40: //SLA+R ACKed
+            if (t->rx_length > 1)
+                LPC_I2C2->I2CONSET = I2C_AA;
+            else
+                LPC_I2C2->I2CONCLR = I2C_AA;
+            LPC_I2C2->I2CONCLR = I2C_SI;
+            break;
+        case 0x50: //data byte received, ACK returned
+            t->rx[_rx_index++] = LPC_I2C2->I2DAT;
+            if (_rx_index < t->rx_length - 1)
+                LPC_I2C2->I2CONSET = I2C_AA;
+            else
+                LPC_I2C2->I2CONCLR = I2C_AA;
+            LPC_I2C2->I2CONCLR = I2C_SI;
+            break;
+        case 0x58: //last data byte received, NACK returned
+            t->rx[_rx_index++] = LPC_I2C2->I2DAT;
+            LPC_I2C2->I2CONSET = I2C_STO;
+            LPC_I2C2->I2CONCLR = I2C_SI;
+            finish(0);
+            break;
+        case 0x38: //arbitration lost, bus is released
+            LPC_I2C2->I2CONCLR = I2C_SI;
+            finish(-1);
+            break;
+        default: //NACK after SLA+W (0x20), data (0x30), SLA+R (0x48) or bus error (0x00)
+            LPC_I2C2->I2CONSET = I2C_STO;
+            LPC_I2C2->I2CONCLR = I2C_SI;
+            finish(-1);
+            break;
+    }
+}
+
+void I2CBus::irq()
+{
+    _instance->step();
+}
+#else
+/**
+* runs the transfer at the head of the queue with blocking mbed I2C calls
+* interrupts stay masked meanwhile so an ISR cannot start a second one
+*/
+void I2CBus::step()
+{
+    I2CTransfer *t;
+    int r = 0;
+
+    __disable_irq();
+    t = _head;
+    if (t == NULL) {
+        __enable_irq();
+        return;
+    }
+    if (t->tx_length > 0)
+        r = _i2c.write(t->address, t->tx, t->tx_length, t->rx_length > 0);
+    if (r == 0 && t->rx_length > 0)
+        r = _i2c.read(t->address, t->rx, t->rx_length);
+    finish(r == 0 ? 0 : -1);
+    __enable_irq();
+}
+
+void I2CBus::irq()
+{
+}
+#endif
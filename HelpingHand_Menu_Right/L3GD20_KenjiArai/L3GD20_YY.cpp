@@ -24,33 +24,55 @@
 
 
 L3GX_GYRO::L3GX_GYRO (PinName p_sda, PinName p_scl,
-                      uint8_t addr, uint8_t data_rate, uint8_t bandwidth, uint8_t fullscale) : _i2c(p_sda, p_scl)
+                      uint8_t addr, uint8_t data_rate, uint8_t bandwidth, uint8_t fullscale) : _i2c(new I2CBus(p_sda, p_scl))
 {
-    _i2c.frequency(400000);
+    _i2c->frequency(addr, 400000);
     initialize (addr, data_rate, bandwidth, fullscale);
 }
 
-L3GX_GYRO::L3GX_GYRO (PinName p_sda, PinName p_scl, uint8_t addr) : _i2c(p_sda, p_scl)
+L3GX_GYRO::L3GX_GYRO (PinName p_sda, PinName p_scl, uint8_t addr) : _i2c(new I2CBus(p_sda, p_scl))
 {
-    _i2c.frequency(400000);
+    _i2c->frequency(addr, 400000);
     initialize (addr, L3GX_DR_95HZ, L3GX_BW_HI, L3GX_FS_250DPS);
 }
 
-L3GX_GYRO::L3GX_GYRO (I2C& p_i2c,
-                      uint8_t addr, uint8_t data_rate, uint8_t bandwidth, uint8_t fullscale) : _i2c(p_i2c)
+L3GX_GYRO::L3GX_GYRO (I2CBus& p_bus,
+                      uint8_t addr, uint8_t data_rate, uint8_t bandwidth, uint8_t fullscale) : _i2c(&p_bus)
 {
-    _i2c.frequency(400000);
+    _i2c->frequency(addr, 400000);
     initialize (addr, data_rate, bandwidth, fullscale);
 }
 
-L3GX_GYRO::L3GX_GYRO (I2C& p_i2c, uint8_t addr) : _i2c(p_i2c)
+L3GX_GYRO::L3GX_GYRO (I2CBus& p_bus, uint8_t addr) : _i2c(&p_bus)
 {
-    _i2c.frequency(400000);
+    _i2c->frequency(addr, 400000);
     initialize (addr, L3GX_DR_95HZ, L3GX_BW_HI, L3GX_FS_250DPS);
 }
 
 void L3GX_GYRO::initialize (uint8_t addr, uint8_t data_rate, uint8_t bandwidth, uint8_t fullscale)
 {
+    _int2 = NULL;
+    drdy_xfer.result = 0;
+    fifo_xfer.address = addr;
+    fifo_xfer.tx = &fifo_reg;
+    fifo_xfer.tx_length = 1;
+    fifo_xfer.rx = fifo_data;
+    fifo_xfer.done = &L3GX_GYRO::fifo_done;
+    fifo_xfer.context = this;
+    fifo_xfer.result = 0;
+    temp_reg = L3GX_OUT_TEMP;
+    temp_xfer.address = addr;
+    temp_xfer.tx = &temp_reg;
+    temp_xfer.tx_length = 1;
+    temp_xfer.rx = &temp_data;
+    temp_xfer.rx_length = 1;
+    temp_xfer.done = &L3GX_GYRO::temp_done;
+    temp_xfer.context = this;
+    temp_xfer.result = 0;
+    drdy_head = 0;
+    drdy_tail = 0;
+    drdy_lost = 0;
+    fs_udps = L3GX_UDPS_250DPS;
     // Check gyro is available of not
     gyro_addr = addr;
     dt[0] = L3GX_WHO_AM_I;//dt[0] is set to 0xf
@@ -58,9 +80,7 @@ void L3GX_GYRO::initialize (uint8_t addr, uint8_t data_rate, uint8_t bandwidth,
     dt[1] = L3GX_WHO_AM_I;//dt[1] os set to 0xf
     //wait_ms(100);
     //printf("after assign:%x;%x\r\n",dt[0],dt[1]);
-    _i2c.write(gyro_addr, dt, 1, true); //this does not change dt[0] or dt[1]
-    //printf("after write:%x;%x\r\n",dt[0],dt[1]);
-    _i2c.read(gyro_addr, dt, 1, false);//dt[0] is set to d7,dt[1] remains same
+    _i2c->transfer(gyro_addr, dt, 1, dt, 1);//dt[0] is set to d7,dt[1] remains same
     //printf("after read:%x;%x\r\n",dt[0],dt[1]);
     if (dt[0] == I_AM_L3G4200D) {
         gyro_ready = 1;
@@ -78,30 +98,33 @@ void L3GX_GYRO::initialize (uint8_t addr, uint8_t data_rate, uint8_t bandwidth,
     dt[1] = 0x0f;
     dt[1] |= data_rate << 6;
     dt[1] |= bandwidth << 4;
-    _i2c.write(gyro_addr, dt, 2, false);
+    _i2c->transfer(gyro_addr, dt, 2, NULL, 0);
     //  Reg.3
     dt[0] = L3GX_CTRL_REG3;
     dt[1] = 0x08;
-    _i2c.write(gyro_addr, dt, 2, false);
+    _i2c->transfer(gyro_addr, dt, 2, NULL, 0);
     //  Reg.4
     dt[0] = L3GX_CTRL_REG4;
     switch (fullscale) {
         case L3GX_FS_250DPS:
             fs_factor = 0.00875;
+            fs_udps = L3GX_UDPS_250DPS;
             dt[1] = 0x80;
             break;
         case L3GX_FS_500DPS:
             fs_factor = 0.0175;
+            fs_udps = L3GX_UDPS_500DPS;
             dt[1] = 0x90;
             break;
         case L3GX_FS_2000DPS:
             fs_factor = 0.07;
+            fs_udps = L3GX_UDPS_2000DPS;
             dt[1] = 0xa0;
             break;
         default:
             ;
     }
-    _i2c.write(gyro_addr, dt, 2, false);
+    _i2c->transfer(gyro_addr, dt, 2, NULL, 0);
 }
 
 void L3GX_GYRO::read_data(float *dt_usr)
@@ -121,8 +144,7 @@ void L3GX_GYRO::read_data(float *dt_usr)
     // In other words, SUB(7) must be equal to ‘1’ while SUB(6-0) represents the address
     // of the first register to be read.
     dt[0] = L3GX_OUT_X_L | 0x80;
-    _i2c.write(gyro_addr, dt, 1, true);
-    _i2c.read(gyro_addr, data, 6, false);
+    _i2c->transfer(gyro_addr, dt, 1, data, 6);
     // data normalization
     dt_usr[0] = float(short(data[1] << 8 | data[0])) * fs_factor;
 //    printf("%0.4x;%f\r\n",data[1] << 8 | data[0],dt_usr[0]);
@@ -130,24 +152,344 @@ void L3GX_GYRO::read_data(float *dt_usr)
     dt_usr[2] = float(short(data[5] << 8 | data[4])) * fs_factor;
 }
 
+bool L3GX_GYRO::read_data_raw(int16_t *dt_raw)
+{
+    char data[6];
+
+    if (gyro_ready == 0) {
+        dt_raw[0] = 0;
+        dt_raw[1] = 0;
+        dt_raw[2] = 0;
+        return false;
+    }
+    dt[0] = L3GX_OUT_X_L | 0x80;
+    if (_i2c->transfer(gyro_addr, dt, 1, data, 6) != 0) {
+        return false;
+    }
+    dt_raw[0] = short(data[1] << 8 | data[0]);
+    dt_raw[1] = short(data[3] << 8 | data[2]);
+    dt_raw[2] = short(data[5] << 8 | data[4]);
+    return true;
+}
+
+int32_t L3GX_GYRO::scale()
+{
+    return fs_udps;
+}
+
+uint8_t L3GX_GYRO::read_if_ready(float *dt_usr)
+{
+    char data[7];
+
+    if (gyro_ready == 0) {
+        return 0;
+    }
+    // STATUS_REG sits right before OUT_X_L, so one multiple byte read
+    // gets the flags and the sample
+    dt[0] = L3GX_STATUS_REG | 0x80;
+    if (_i2c->transfer(gyro_addr, dt, 1, data, 7) != 0) {
+        return 0;
+    }
+    if (data[0] & L3GX_ZYXDA) {
+        dt_usr[0] = float(short(data[2] << 8 | data[1])) * fs_factor;
+        dt_usr[1] = float(short(data[4] << 8 | data[3])) * fs_factor;
+        dt_usr[2] = float(short(data[6] << 8 | data[5])) * fs_factor;
+    }
+    return (uint8_t)data[0];
+}
+
 int8_t L3GX_GYRO::read_temp()
 {
     if (gyro_ready == 1) {
         dt[0] = L3GX_OUT_TEMP;
-        _i2c.write(gyro_addr, dt, 1, true);
-        _i2c.read(gyro_addr, dt, 1, false);
+        if (_i2c->transfer(gyro_addr, dt, 1, dt, 1) != 0) {
+            dt[0] = L3GX_TEMP_NONE;
+        }
     } else {
-        dt[0] = 99;
+        dt[0] = L3GX_TEMP_NONE;
     }
     return (int8_t)dt[0];
 }
 
+bool L3GX_GYRO::read_temp_async(void (*fptr)(int8_t temp))
+{
+    if (temp_xfer.result == 1) {
+        return false;
+    }
+    if (gyro_ready == 0) {
+        fptr(L3GX_TEMP_NONE);
+        return true;
+    }
+    temp_fn = fptr;
+    return _i2c->transfer(&temp_xfer);
+}
+
+void L3GX_GYRO::temp_done(I2CTransfer *t)
+{
+    L3GX_GYRO *g = (L3GX_GYRO *)t->context;
+
+    if (t->result != 0) {
+        g->temp_fn(L3GX_TEMP_NONE);
+    } else {
+        g->temp_fn((int8_t)g->temp_data);
+    }
+}
+
+void L3GX_GYRO::fifo_stream(uint8_t watermark)
+{
+    // restart from bypass mode so FIFO is empty
+    write_reg(L3GX_FIFO_CTRL_REG, L3GX_FM_BYPASS << 5);
+    write_reg(L3GX_CTRL_REG5, read_reg(L3GX_CTRL_REG5) | 0x40);   // FIFO_EN
+    write_reg(L3GX_FIFO_CTRL_REG, (L3GX_FM_STREAM << 5) | (watermark & 0x1f));
+}
+
+void L3GX_GYRO::fifo_bypass()
+{
+    write_reg(L3GX_FIFO_CTRL_REG, L3GX_FM_BYPASS << 5);
+    write_reg(L3GX_CTRL_REG5, read_reg(L3GX_CTRL_REG5) & ~0x40);
+}
+
+int L3GX_GYRO::fifo_count()
+{
+    char src;
+
+    if (gyro_ready == 0) {
+        return 0;
+    }
+    dt[0] = L3GX_FIFO_SRC_REG;
+    if (_i2c->transfer(gyro_addr, dt, 1, &src, 1) != 0) {
+        return -1;
+    }
+    if (src & 0x40) {   // overrun, all levels are full
+        return L3GX_FIFO_DEPTH;
+    }
+    return src & 0x1f;
+}
+
+int L3GX_GYRO::read_fifo(float *dt_usr, int n)
+{
+    int16_t raw[L3GX_FIFO_DEPTH * 3];
+    int num;
+
+    num = read_fifo_raw(raw, n);
+    for (int i = 0; i < num * 3; i++) {
+        dt_usr[i] = float(raw[i]) * fs_factor;
+    }
+    return num;
+}
+
+int L3GX_GYRO::read_fifo_raw(int16_t *dt_raw, int n)
+{
+    char data[L3GX_FIFO_DEPTH * 6];
+    int num;
+
+    num = fifo_count();
+    if (num > n) {
+        num = n;
+    }
+    if (num <= 0) {
+        return num;
+    }
+    // With FIFO enabled, the address rolls back from OUT_Z_H to OUT_X_L,
+    // so all samples come out in one multiple byte read
+    dt[0] = L3GX_OUT_X_L | 0x80;
+    if (_i2c->transfer(gyro_addr, dt, 1, data, num * 6) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < num; i++) {
+        char *d = &data[i * 6];
+        dt_raw[i * 3]     = short(d[1] << 8 | d[0]);
+        dt_raw[i * 3 + 1] = short(d[3] << 8 | d[2]);
+        dt_raw[i * 3 + 2] = short(d[5] << 8 | d[4]);
+    }
+    return num;
+}
+
+bool L3GX_GYRO::read_fifo_async(int16_t *dt_raw, int n, void (*fptr)(int num))
+{
+    if (fifo_xfer.result == 1) {
+        return false;
+    }
+    if (gyro_ready == 0) {
+        fptr(0);
+        return true;
+    }
+    fifo_raw = dt_raw;
+    fifo_max = n < L3GX_FIFO_DEPTH ? n : L3GX_FIFO_DEPTH;
+    fifo_fn = fptr;
+    fifo_reg = L3GX_FIFO_SRC_REG;
+    fifo_xfer.rx_length = 1;
+    return _i2c->transfer(&fifo_xfer);
+}
+
+void L3GX_GYRO::fifo_done(I2CTransfer *t)
+{
+    L3GX_GYRO *g = (L3GX_GYRO *)t->context;
+    char *d = g->fifo_data;
+    int num;
+
+    if (t->result != 0) {
+        g->fifo_fn(-1);
+        return;
+    }
+    if (t->rx_length == 1) {
+        // FIFO_SRC_REG is in, queue the burst for that many samples
+        num = (d[0] & 0x40) ? L3GX_FIFO_DEPTH : (d[0] & 0x1f);
+        if (num > g->fifo_max) {
+            num = g->fifo_max;
+        }
+        if (num <= 0) {
+            g->fifo_fn(0);
+            return;
+        }
+        g->fifo_reg = L3GX_OUT_X_L | 0x80;
+        t->rx_length = num * 6;
+        g->_i2c->transfer(t);   // result was set before this call
+        return;
+    }
+    num = t->rx_length / 6;
+    for (int i = 0; i < num; i++) {
+        d = &g->fifo_data[i * 6];
+        g->fifo_raw[i * 3]     = short(d[1] << 8 | d[0]);
+        g->fifo_raw[i * 3 + 1] = short(d[3] << 8 | d[2]);
+        g->fifo_raw[i * 3 + 2] = short(d[5] << 8 | d[4]);
+    }
+    g->fifo_fn(num);
+}
+
+void L3GX_GYRO::attach_watermark(PinName int2, void (*fptr)(void))
+{
+    if (_int2 == NULL) {
+        _int2 = new InterruptIn(int2);
+    }
+    _int2->rise(fptr);
+    // INT2 signals watermark (I2_WTM) instead of data ready
+    write_reg(L3GX_CTRL_REG3, 0x04);
+}
+
+void L3GX_GYRO::attach_drdy(PinName int2)
+{
+    drdy_reg = L3GX_OUT_X_L | 0x80;
+    drdy_xfer.address = gyro_addr;
+    drdy_xfer.tx = &drdy_reg;
+    drdy_xfer.tx_length = 1;
+    drdy_xfer.rx = drdy_data;
+    drdy_xfer.rx_length = 6;
+    drdy_xfer.done = &L3GX_GYRO::drdy_done;
+    drdy_xfer.context = this;
+    drdy_head = drdy_tail;
+    drdy_lost = 0;
+    drdy_fails = 0;
+    if (_int2 == NULL) {
+        _int2 = new InterruptIn(int2);
+    }
+    _int2->rise(this, &L3GX_GYRO::drdy_rise);
+    // INT2 signals data ready (I2_DRDY)
+    write_reg(L3GX_CTRL_REG3, 0x08);
+    // DRDY stays high until the data is read, so no edge would come
+    if (_int2->read()) {
+        drdy_rise();
+    }
+}
+
+void L3GX_GYRO::drdy_rise()
+{
+    if (gyro_ready == 1) {
+        _i2c->transfer(&drdy_xfer);     // ignored if a read is still queued
+    }
+}
+
+void L3GX_GYRO::drdy_done(I2CTransfer *t)
+{
+    L3GX_GYRO *g = (L3GX_GYRO *)t->context;
+    char *d = g->drdy_data;
+    uint8_t head = g->drdy_head;
+    uint8_t next = (head + 1) & (L3GX_DRDY_BUFFER - 1);
+
+    if (t->result != 0) {
+        // a bus that keeps failing is left alone, available() retries
+        if (++g->drdy_fails >= L3GX_DRDY_RETRIES) {
+            g->drdy_lost++;
+            return;
+        }
+    } else {
+        g->drdy_fails = 0;
+        if (next == g->drdy_tail) {
+            g->drdy_lost++;
+        } else {
+            g->drdy_buf[head][0] = short(d[1] << 8 | d[0]);
+            g->drdy_buf[head][1] = short(d[3] << 8 | d[2]);
+            g->drdy_buf[head][2] = short(d[5] << 8 | d[4]);
+            g->drdy_head = next;    // publish after the slot is written
+        }
+    }
+    // a failed read, or a sample that came in during the read, leaves
+    // DRDY high without a new edge
+    if (g->_int2->read()) {
+        g->drdy_rise();
+    }
+}
+
+// nothing is queued once the retries ran out, and DRDY stays high,
+// so the reader starts them again
+void L3GX_GYRO::drdy_resume()
+{
+    if (drdy_fails >= L3GX_DRDY_RETRIES && _int2->read()) {
+        drdy_fails = 0;
+        drdy_rise();
+    }
+}
+
+int L3GX_GYRO::available()
+{
+    drdy_resume();
+    return (drdy_head - drdy_tail) & (L3GX_DRDY_BUFFER - 1);
+}
+
+int L3GX_GYRO::get_data(float *dt_usr)
+{
+    uint8_t tail;
+
+    drdy_resume();
+    tail = drdy_tail;
+
+    if (tail == drdy_head) {
+        return 0;
+    }
+    dt_usr[0] = float(drdy_buf[tail][0]) * fs_factor;
+    dt_usr[1] = float(drdy_buf[tail][1]) * fs_factor;
+    dt_usr[2] = float(drdy_buf[tail][2]) * fs_factor;
+    drdy_tail = (tail + 1) & (L3GX_DRDY_BUFFER - 1);   // free the slot last
+    return 1;
+}
+
+int L3GX_GYRO::get_data_raw(int16_t *dt_raw)
+{
+    uint8_t tail;
+
+    drdy_resume();
+    tail = drdy_tail;
+
+    if (tail == drdy_head) {
+        return 0;
+    }
+    dt_raw[0] = drdy_buf[tail][0];
+    dt_raw[1] = drdy_buf[tail][1];
+    dt_raw[2] = drdy_buf[tail][2];
+    drdy_tail = (tail + 1) & (L3GX_DRDY_BUFFER - 1);   // free the slot last
+    return 1;
+}
+
+uint32_t L3GX_GYRO::dropped()
+{
+    return drdy_lost;
+}
+
 uint8_t L3GX_GYRO::read_id()
 {
     dt[0] = L3GX_WHO_AM_I;
     printf("dt[0]: %x\r\n",dt[0]);
-    _i2c.write(gyro_addr, dt, 1, true);
-    _i2c.read(gyro_addr, dt, 1, false);
+    _i2c->transfer(gyro_addr, dt, 1, dt, 1);
     return (uint8_t)dt[0];
 }
 
@@ -155,8 +497,7 @@ uint8_t L3GX_GYRO::data_ready()
 {
     if (gyro_ready == 1) {
         dt[0] = L3GX_STATUS_REG;
-        _i2c.write(gyro_addr, dt, 1, true);
-        _i2c.read(gyro_addr, dt, 1, false);
+        _i2c->transfer(gyro_addr, dt, 1, dt, 1);
         if (!(dt[0] & 0x01)) {
             return 0;
         }
@@ -166,15 +507,14 @@ uint8_t L3GX_GYRO::data_ready()
 
 void L3GX_GYRO::frequency(int hz)
 {
-    _i2c.frequency(hz);
+    _i2c->frequency(gyro_addr, hz);
 }
 
 uint8_t L3GX_GYRO::read_reg(uint8_t addr)
 {
     if (gyro_ready == 1) {
         dt[0] = addr;
-        _i2c.write(gyro_addr, dt, 1, true);
-        _i2c.read(gyro_addr, dt, 1, false);
+        _i2c->transfer(gyro_addr, dt, 1, dt, 1);
     } else {
         dt[0] = 0xff;
     }
@@ -186,6 +526,6 @@ void L3GX_GYRO::write_reg(uint8_t addr, uint8_t data)
     if (gyro_ready == 1) {
         dt[0] = addr;
         dt[1] = data;
-        _i2c.write(gyro_addr, dt, 2, false);
+        _i2c->transfer(gyro_addr, dt, 2, NULL, 0);
     }
 }
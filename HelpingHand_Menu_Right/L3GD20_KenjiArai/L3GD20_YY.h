@@ -24,6 +24,7 @@
 #define L3GD20_GYRO_H
 
 #include "mbed.h"
+#include "I2CBus.h"
 
 //  L3G4200DMEMS Address
 //  7bit address = 0b110100x(0x68 or 0x69 depends on SA0/SDO)
@@ -103,6 +104,29 @@
 #define L3GX_FS_500DPS       1
 #define L3GX_FS_2000DPS      2
 
+// Raw sample scale for each full scale, micro dps per LSB
+#define L3GX_UDPS_250DPS     8750
+#define L3GX_UDPS_500DPS     17500
+#define L3GX_UDPS_2000DPS    70000
+
+// STATUS_REG bits
+#define L3GX_ZYXDA           0x08   // new X, Y & Z data available
+#define L3GX_ZYXOR           0x80   // X, Y & Z data overwritten before read
+
+// read_temp() when there is no reading, gyro not found or bus error
+#define L3GX_TEMP_NONE       99
+
+// FIFO mode (FIFO_CTRL_REG FM2-0)
+#define L3GX_FM_BYPASS       0
+#define L3GX_FM_FIFO         1
+#define L3GX_FM_STREAM       2
+#define L3GX_FIFO_DEPTH      32
+
+// Samples held by the DRDY interrupt mode (power of 2)
+#define L3GX_DRDY_BUFFER     32
+// Failed DRDY reads retried in a row from the interrupt, then available() restarts
+#define L3GX_DRDY_RETRIES    3
+
 //Convert from degrees to radians.
 #define toRadians(x) (x * 0.01745329252)
 //Convert from radians to degrees.
@@ -118,8 +142,8 @@
  * L3GX_GYRO gyro(p_sda, p_scl, chip_addr, datarate, bandwidth, fullscale);
  * // If you connected I2C line not only this device but also other devices,
  * //     you need to declare following method.
- * I2C i2c(dp5,dp27);              // SDA, SCL
- * L3GX_GYRO gyro(i2c, chip_addr, datarate, bandwidth, fullscale);
+ * I2CBus bus(dp5,dp27);           // SDA, SCL
+ * L3GX_GYRO gyro(bus, chip_addr, datarate, bandwidth, fullscale);
  *
  * int main() {
  * float f[3];
@@ -158,27 +182,34 @@ public:
     L3GX_GYRO(PinName p_sda, PinName p_scl, uint8_t addr);
 
     /** Configure data pin (with other devices on I2C line)
-      * @param I2C previous definition
+      * @param I2CBus shared with the other devices, 400kHz is set for this address
       * @param other parameters -> please see L3GX_GYRO(PinName p_sda, PinName p_scl,...)
       */
-    L3GX_GYRO(I2C& p_i2c,
+    L3GX_GYRO(I2CBus& p_bus,
               uint8_t addr, uint8_t data_rate, uint8_t bandwidth, uint8_t fullscale);
 
     /** Configure data pin (with other devices on I2C line)
-      * @param I2C previous definition
+      * @param I2CBus shared with the other devices, 400kHz is set for this address
       * @param other parameters -> please see L3GX_GYRO(PinName p_sda, PinName p_scl,...)
       * @default output data rate selection = DR_100HZ/DR_95HZ
       * @default bandwidth selection = BW_HI
       * @default full scale selection = FS_250DPS
       */
-    L3GX_GYRO(I2C& p_i2c, uint8_t addr);
+    L3GX_GYRO(I2CBus& p_bus, uint8_t addr);
 
     /** Read a tow's complemet type data from Gyro
       * @param none
-      * @return temperature unit:degreeC(Celsius)
+      * @return temperature unit:degreeC(Celsius), L3GX_TEMP_NONE = no reading
       */
     int8_t read_temp();
 
+    /** Read the temperature by a queued bus transfer, without waiting
+      * @param function called from interrupt context with the temperature,
+      *        L3GX_TEMP_NONE = no reading
+      * @return false = the previous read has not finished yet
+      */
+    bool read_temp_async(void (*fptr)(int8_t temp));
+
     /** Read a float type data from Gyro
       * @param float type of three arry's address, e.g. float dt_usr[3];
       * @return Gyro motion data unit in param array:dps(degree per second)
@@ -186,6 +217,110 @@ public:
       */
     void read_data(float *dt_usr);
 
+    /** Read STATUS_REG and, if new data is there, X,Y & Z in the same burst
+      * @param float type of three arry's address, e.g. float dt_usr[3];
+      * @return STATUS_REG, dt_usr is only filled (dps) when L3GX_ZYXDA is set
+      * @return 0 on a bus error
+      * @return L3GX_ZYXOR set = samples were lost since the last read
+      */
+    uint8_t read_if_ready(float *dt_usr);
+
+    /** Read Gyro data without conversion
+      * @param int16_t type of three arry's address, e.g. int16_t dt_raw[3];
+      * @return dt_raw[0]->x, dt_raw[1]->y, dt_raw[2]->z in units of scale() udps
+      * @return true = read, false = no gyro or bus error, dt_raw is left as it was on a bus error
+      */
+    bool read_data_raw(int16_t *dt_raw);
+
+    /** Raw data scale for the full scale set in the constructor
+      * @param none
+      * @return micro dps per LSB, L3GX_UDPS_250DPS to L3GX_UDPS_2000DPS
+      */
+    int32_t scale();
+
+    /** Enable FIFO in stream mode (oldest sample is dropped when full)
+      * @param watermark level 0-31, WTM is raised when more samples are queued
+      * @return none
+      */
+    void fifo_stream(uint8_t watermark);
+
+    /** Disable FIFO (bypass mode), the queued samples are discarded
+      * @param none
+      * @return none
+      */
+    void fifo_bypass();
+
+    /** Number of samples waiting in FIFO
+      * @param none
+      * @return 0 to L3GX_FIFO_DEPTH, -1 = bus error
+      */
+    int fifo_count();
+
+    /** Read queued samples from FIFO in one burst transaction
+      * @param float type array of 3 * n, e.g. float dt_usr[3 * L3GX_FIFO_DEPTH];
+      * @param maximum number of samples to read
+      * @return number of samples read, dps in dt_usr[3*i]->x, [3*i+1]->y, [3*i+2]->z
+      * @return -1 = bus error, nothing was read
+      */
+    int read_fifo(float *dt_usr, int n);
+
+    /** Read queued samples from FIFO in one burst, without conversion
+      * @param int16_t type array of 3 * n, e.g. int16_t dt_raw[3 * L3GX_FIFO_DEPTH];
+      * @param maximum number of samples to read
+      * @return number of samples read, in units of scale() udps, -1 = bus error
+      */
+    int read_fifo_raw(int16_t *dt_raw, int n);
+
+    /** Drain FIFO by queued bus transfers, without waiting
+      *  FIFO_SRC_REG is read first, then the samples in one burst
+      * @param int16_t type array of 3 * n, written before fptr is called
+      * @param maximum number of samples to read
+      * @param function called from interrupt context with the number of
+      *        samples read (scale() udps per LSB), -1 = bus error
+      * @return false = the previous drain has not finished yet
+      */
+    bool read_fifo_async(int16_t *dt_raw, int n, void (*fptr)(int num));
+
+    /** Call a function when FIFO reaches the watermark (use with fifo_stream())
+      * @param pin connected to DRDY/INT2, the watermark replaces DRDY on it
+      * @param function called from interrupt context
+      * @return none
+      */
+    void attach_watermark(PinName int2, void (*fptr)(void));
+
+    /** Read each new sample when DRDY rises on INT2, without polling
+      *  samples are read by a queued bus transfer and kept in a buffer
+      * @param pin connected to DRDY/INT2
+      * @return none
+      */
+    void attach_drdy(PinName int2);
+
+    /** Number of samples waiting in the DRDY buffer (use with attach_drdy())
+      *  this and get_data() restart the reads after L3GX_DRDY_RETRIES failed
+      * @param none
+      * @return 0 to L3GX_DRDY_BUFFER - 1
+      */
+    int available();
+
+    /** Take the oldest sample from the DRDY buffer
+      * @param float type of three arry's address, e.g. float dt_usr[3];
+      * @return 1 = dt_usr is filled (dps), 0 = buffer is empty
+      */
+    int get_data(float *dt_usr);
+
+    /** Take the oldest sample from the DRDY buffer, without conversion
+      * @param int16_t type of three arry's address, e.g. int16_t dt_raw[3];
+      * @return 1 = dt_raw is filled (scale() udps per LSB), 0 = buffer is empty
+      */
+    int get_data_raw(int16_t *dt_raw);
+
+    /** Number of samples lost because the DRDY buffer was full
+      *  or the bus failed L3GX_DRDY_RETRIES times in a row
+      * @param none
+      * @return count since attach_drdy()
+      */
+    uint32_t dropped();
+
     /** Read a Gyro ID number
       * @param none
       * @return if STM MEMS Gyro, it should be I_AM_L3G4200D(0xd3) or I_AM_L3GD20(0xd4)
@@ -198,7 +333,7 @@ public:
       */
     uint8_t data_ready();
 
-    /** Set I2C clock frequency
+    /** Set I2C clock frequency (used for this device only)
       * @param freq.
       * @return none
       */
@@ -219,15 +354,43 @@ public:
 
 protected:
     void initialize(uint8_t, uint8_t, uint8_t, uint8_t);
+    void drdy_rise();
+    void drdy_resume();
+    static void drdy_done(I2CTransfer *t);
+    static void fifo_done(I2CTransfer *t);
+    static void temp_done(I2CTransfer *t);
 
-    I2C _i2c;
+    I2CBus *_i2c;
+    InterruptIn *_int2;
 
 private:
     float   fs_factor;  // full scale factor
+    int32_t fs_udps;    // full scale factor, micro dps per LSB
     char    dt[2];      // working buffer
     uint8_t gyro_addr;  // gyro sensor address
     uint8_t gyro_id;    // gyro ID
     uint8_t gyro_ready; // gyro is on I2C line = 1, not = 0
+    // DRDY mode, filled by interrupt, emptied by get_data()
+    I2CTransfer drdy_xfer;
+    char    drdy_reg;
+    char    drdy_data[6];
+    short   drdy_buf[L3GX_DRDY_BUFFER][3];
+    volatile uint8_t  drdy_head;    // written by interrupt only
+    volatile uint8_t  drdy_tail;    // written by get_data() only
+    volatile uint32_t drdy_lost;
+    volatile uint8_t  drdy_fails;   // failed reads in a row
+    // queued FIFO drain, FIFO_SRC_REG first, then the burst
+    I2CTransfer fifo_xfer;
+    char    fifo_reg;
+    char    fifo_data[L3GX_FIFO_DEPTH * 6];
+    int16_t *fifo_raw;
+    int     fifo_max;
+    void    (*fifo_fn)(int num);
+    // queued OUT_TEMP read
+    I2CTransfer temp_xfer;
+    char    temp_reg;
+    char    temp_data;
+    void    (*temp_fn)(int8_t temp);
 };
 
 #endif      // L3GD20_GYRO_H
@@ -0,0 +1,52 @@
+/**
+* Rotation speed of the hand from the gyro, see RotationSpeed.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "RotationSpeed.h"
+
+//floor(sqrt(v)), one result bit per step
+static uint32_t isqrt(uint32_t v)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > v)
+        bit >>= 2;
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+RotationSpeed::RotationSpeed(int sample_us, int gyro_udps, int tau_ms)
+{
+    _udps = gyro_udps;
+    _k = (int32_t)((int64_t)sample_us * 32768 / (tau_ms * 1000 + sample_us));
+    _speed = 0;
+}
+
+void RotationSpeed::update(const int32_t *gyro)
+{
+    //the samples are int16, so the three squares add up below 2^32
+    uint32_t rate = isqrt((uint32_t)gyro[0] * (uint32_t)gyro[0]
+                          + (uint32_t)gyro[1] * (uint32_t)gyro[1]
+                          + (uint32_t)gyro[2] * (uint32_t)gyro[2]);
+    _speed += (int32_t)(((int64_t)((int32_t)(rate << 8) - _speed) * _k) >> 15);
+}
+
+int32_t RotationSpeed::speed()
+{
+    return _speed >> 8;
+}
+
+int32_t RotationSpeed::mdps()
+{
+    return (int32_t)((int64_t)_speed * _udps / 256000);
+}
@@ -0,0 +1,155 @@
+/**
+* Cooperative run-to-completion task scheduler, see Scheduler.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "Scheduler.h"
+
+//the interrupt itself ends the __WFI, nothing to do
+static void wake_up()
+{
+}
+
+Task::Task(Scheduler &sched, void (*fn)(void), uint32_t deadline_us)
+{
+    _fn = fn;
+    _deadline_us = deadline_us;
+    _period = 0;
+    _release = 0;
+    _due = 0;
+    _timed = false;
+    _ready = false;
+    _posted = false;
+    _runs = 0;
+    _misses = 0;
+    _worst = 0;
+    sched.add(this);
+}
+
+uint32_t Task::runs()
+{
+    return _runs;
+}
+
+uint32_t Task::misses()
+{
+    return _misses;
+}
+
+uint32_t Task::worst_us()
+{
+    return _worst;
+}
+
+Scheduler::Scheduler(TimerWheel &wheel) : _wake(wheel)
+{
+    _count = 0;
+}
+
+void Scheduler::add(Task *t)
+{
+    if (_count < SCHED_TASKS)
+        _tasks[_count++] = t;
+}
+
+void Scheduler::start(Task *t, uint32_t period_us)
+{
+    t->_period = period_us;
+    t->_release = us_ticker_read() + period_us;
+    t->_timed = true;
+}
+
+void Scheduler::once(Task *t, uint32_t delay_us)
+{
+    t->_period = 0;
+    t->_release = us_ticker_read() + delay_us;
+    t->_timed = true;
+}
+
+void Scheduler::stop(Task *t)
+{
+    t->_timed = false;
+}
+
+void Scheduler::post(Task *t)
+{
+    t->_posted = true;
+}
+
+/**
+* t is released at time at
+*/
+void Scheduler::release(Task *t, uint32_t at)
+{
+    if (t->_ready) {
+        t->_misses++;   //the last release has not run yet, they merge
+        return;
+    }
+    t->_ready = true;
+    t->_due = at + t->_deadline_us;
+}
+
+bool Scheduler::posted()
+{
+    for (int i = 0; i < _count; i++)
+        if (_tasks[i]->_posted)
+            return true;
+    return false;
+}
+
+void Scheduler::dispatch()
+{
+    uint32_t now = us_ticker_read();
+    Task *run = NULL;
+    bool timed = false;
+    uint32_t wait = 0;
+
+    for (int i = 0; i < _count; i++) {
+        Task *t = _tasks[i];
+        if (t->_posted) {
+            t->_posted = false;
+            release(t, now);
+        }
+        if (t->_timed && (int32_t)(now - t->_release) >= 0) {
+            release(t, t->_release);
+            if (t->_period) {
+                t->_release += t->_period;
+                if ((int32_t)(now - t->_release) >= 0) {
+                    //fell whole periods behind, skip them
+                    uint32_t n = (now - t->_release) / t->_period + 1;
+                    t->_misses += n;
+                    t->_release += n * t->_period;
+                }
+            } else {
+                t->_timed = false;
+            }
+        }
+        if (t->_ready && (run == NULL || (int32_t)(t->_due - run->_due) < 0))
+            run = t;
+        if (t->_timed && (!timed || t->_release - now < wait)) {
+            wait = t->_release - now;
+            timed = true;
+        }
+    }
+
+    if (run != NULL) {
+        run->_ready = false;
+        uint32_t begin = us_ticker_read();
+        run->_fn();
+        uint32_t end = us_ticker_read();
+        run->_runs++;
+        if (end - begin > run->_worst)
+            run->_worst = end - begin;
+        if ((int32_t)(end - run->_due) > 0)
+            run->_misses++;
+        return;
+    }
+
+    //idle: sleep until the next timed release or a post from an ISR
+    if (timed)
+        _wake.once_us(&wake_up, wait);
+    __disable_irq();
+    if (!posted())
+        __WFI();    //wakes on a pending interrupt even with them disabled
+    __enable_irq();
+}
@@ -0,0 +1,458 @@
+/**
+* Gyro bias and accelerometer offset/scale, see SensorCal.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "SensorCal.h"
+#include <string.h>
+#include <stddef.h>
+
+#define CAL_MAGIC 0x32434848    //"HHC2"
+#define CAL_ERASED 0xffffffff
+
+//one per flash page, the newest valid seq wins
+struct CalRecord {
+    uint32_t magic;
+    uint32_t seq;
+    CalData data;
+    uint32_t check;
+};
+
+static uint32_t cal_check(const CalRecord *r)
+{
+    const uint8_t *p = (const uint8_t *)r;
+    uint32_t sum = 0;
+
+    for (unsigned i = 0; i < offsetof(CalRecord, check); i++)
+        sum = (sum << 1 | sum >> 31) + p[i];
+    return ~sum;
+}
+
+static int16_t clamp16(int32_t v)
+{
+    if (v > 32767)
+        return 32767;
+    if (v < -32768)
+        return -32768;
+    return v;
+}
+
+#if defined(TARGET_LPC1768)
+//IAP commands and status, UM10360 chapter 32
+#define IAP_LOCATION 0x1fff1ff1
+#define IAP_PREPARE 50
+#define IAP_COPY 51
+#define IAP_ERASE 52
+#define IAP_SUCCESS 0
+
+typedef void (*IapEntry)(uint32_t *cmd, uint32_t *result);
+
+static const uint8_t *const cal_flash = (const uint8_t *)CAL_FLASH_ADDR;
+
+//the flash cannot be read while IAP runs, so nothing else may either
+static bool iap(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t c4)
+{
+    uint32_t cmd[5] = {c0, c1, c2, c3, c4};
+    uint32_t result[5];
+
+    ((IapEntry)IAP_LOCATION)(cmd, result);
+    return result[0] == IAP_SUCCESS;
+}
+
+static bool flash_erase()
+{
+    bool ok;
+
+    __disable_irq();
+    ok = iap(IAP_PREPARE, CAL_FLASH_SECTOR, CAL_FLASH_SECTOR, 0, 0)
+         && iap(IAP_ERASE, CAL_FLASH_SECTOR, CAL_FLASH_SECTOR, SystemCoreClock / 1000, 0);
+    __enable_irq();
+    return ok;
+}
+
+static bool flash_write(int page, const uint32_t *buf)
+{
+    bool ok;
+
+    __disable_irq();
+    ok = iap(IAP_PREPARE, CAL_FLASH_SECTOR, CAL_FLASH_SECTOR, 0, 0)
+         && iap(IAP_COPY, CAL_FLASH_ADDR + page * CAL_PAGE, (uint32_t)buf, CAL_PAGE,
+                SystemCoreClock / 1000);
+    __enable_irq();
+    return ok;
+}
+#else
+//stands in for the sector, starts erased
+static uint8_t cal_ram[CAL_FLASH_SIZE];
+static bool cal_ram_ready = false;
+static const uint8_t *const cal_flash = cal_ram;
+
+static bool flash_erase()
+{
+    memset(cal_ram, 0xff, sizeof(cal_ram));
+    cal_ram_ready = true;
+    return true;
+}
+
+static bool flash_write(int page, const uint32_t *buf)
+{
+    memcpy(&cal_ram[page * CAL_PAGE], buf, CAL_PAGE);
+    return true;
+}
+#endif
+
+SensorCal::SensorCal(int gyro_udps, int gyro_sample_us, int acc_1g, int window_ms,
+                     int still_dps, int still_mg)
+{
+    memset(&_cal, 0, sizeof(_cal));
+    _acc_1g = acc_1g;
+    _gyro_band = (int32_t)((int64_t)still_dps * 1000000 / gyro_udps);
+    _gyro_jump = (int32_t)((int64_t)CAL_GYRO_JUMP_DPS * 1000000 / gyro_udps);
+    _gyro_step = (int32_t)((int64_t)CAL_SAVE_DPS * 1000000 / gyro_udps);
+    _acc_band = still_mg * acc_1g / 1000;
+    _window = window_ms * 1000 / gyro_sample_us;
+    if (_window < 1)
+        _window = 1;
+    _temp = 0;
+    _temp_known = false;
+    apply();
+    _stored = _cal;
+    _saved = false;
+    _seq = 0;
+    _page = -1;
+    _still_windows = 0;
+    reset_window();
+#if !defined(TARGET_LPC1768)
+    if (!cal_ram_ready)
+        flash_erase();
+#endif
+}
+
+/**
+* finds the newest valid record and the first erased page
+* pages are written in order, so the first erased one ends the log
+*/
+const CalRecord *SensorCal::scan()
+{
+    const CalRecord *best = NULL;
+    int page;
+
+    for (page = 0; page < CAL_PAGES; page++) {
+        const CalRecord *r = (const CalRecord *)&cal_flash[page * CAL_PAGE];
+        if (r->magic == CAL_ERASED)
+            break;
+        if (r->magic != CAL_MAGIC || r->check != cal_check(r))
+            continue;
+        if (best == NULL || (int32_t)(r->seq - best->seq) > 0)
+            best = r;
+    }
+    _page = page;
+    if (best)
+        _seq = best->seq;
+    return best;
+}
+
+bool SensorCal::load()
+{
+    const CalRecord *r = scan();
+
+    if (r == NULL)
+        return false;
+    __disable_irq();
+    _cal = r->data;
+    //until temperature() has a reading the bias is the one saved
+    if (!_temp_known)
+        _temp = _cal.temp;
+    apply();
+    __enable_irq();
+    _stored = r->data;
+    _saved = true;
+    return true;
+}
+
+bool SensorCal::save(int8_t temp)
+{
+    uint32_t buf[CAL_PAGE / 4];
+    CalRecord rec;
+
+    if (_page < 0)
+        scan();
+    __disable_irq();
+    _cal.temp = temp;
+    rec.data = _cal;
+    __enable_irq();
+    rec.magic = CAL_MAGIC;
+    rec.seq = _seq + 1;
+    rec.check = cal_check(&rec);
+    memset(buf, 0xff, sizeof(buf));
+    memcpy(buf, &rec, sizeof(rec));
+
+    if (_page >= CAL_PAGES) {
+        if (!flash_erase())
+            return false;
+        _page = 0;
+    }
+    if (!flash_write(_page, buf) || memcmp(&cal_flash[_page * CAL_PAGE], &rec, sizeof(rec)) != 0) {
+        _page = CAL_PAGES;      //erase before the next try
+        return false;
+    }
+    _page++;
+    _seq = rec.seq;
+    _stored = rec.data;
+    _saved = true;
+    return true;
+}
+
+bool SensorCal::dirty()
+{
+    CalData c = _cal;
+    int32_t acc_step = _acc_1g / 100;
+
+    if (c.valid == 0)
+        return false;
+    if (!_saved || c.valid != _stored.valid || c.bins != _stored.bins)
+        return true;
+    for (int i = 0; i < 3; i++) {
+        if (abs(c.gyro_bias[i] - _stored.gyro_bias[i]) > _gyro_step
+                || abs(c.acc_offset[i] - _stored.acc_offset[i]) > acc_step
+                || abs(c.acc_scale[i] - _stored.acc_scale[i]) > acc_step)
+            return true;
+    }
+    return false;
+}
+
+void SensorCal::temperature(int8_t temp)
+{
+    __disable_irq();
+    _temp = temp;
+    _temp_known = true;
+    if (_cal.bins == 0)
+        _cal.temp_origin = temp;
+    follow_temperature();
+    __enable_irq();
+}
+
+/**
+* derives the working values from _cal, after a load
+*/
+void SensorCal::apply()
+{
+    fit();
+    follow_temperature();
+    for (int i = 0; i < 3; i++) {
+        if (_cal.valid & (CAL_ACC_X << i)) {
+            _acc_hi[i] = _cal.acc_offset[i] + _cal.acc_scale[i];
+            _acc_lo[i] = _cal.acc_offset[i] - _cal.acc_scale[i];
+            _acc_gain[i] = (_acc_1g << 14) / _cal.acc_scale[i];
+        } else {
+            _acc_hi[i] = -32768;
+            _acc_lo[i] = 32767;
+            _acc_gain[i] = 1 << 14;
+        }
+    }
+}
+
+/**
+* weighted least squares line through the gyro bias bins, per axis
+* x is the bin (degrees), y the bin bias (Q2); flat with one bin
+*/
+void SensorCal::fit()
+{
+    for (int i = 0; i < 3; i++) {
+        int64_t sw = 0, sx = 0, sxx = 0, sy = 0, sxy = 0;
+        for (int b = 0; b < CAL_TEMP_BINS; b++) {
+            int w = _cal.bin_weight[b];
+            int64_t y = _cal.bin_bias[b][i];
+            sw += w;
+            sx += w * b;
+            sxx += w * b * b;
+            sy += w * y;
+            sxy += w * b * y;
+        }
+        if (sw == 0) {
+            _fit_a[i] = 0;
+            _fit_b[i] = 0;
+            continue;
+        }
+        int64_t den = sw * sxx - sx * sx;
+        int64_t slope = den > 0 ? ((sw * sxy - sx * sy) << 8) / den : 0;
+        _fit_b[i] = (int32_t)slope;
+        _fit_a[i] = (int32_t)(((sy << 8) - slope * sx) / sw);
+    }
+}
+
+/**
+* the bias applied is the fitted line at the temperature now
+*/
+void SensorCal::follow_temperature()
+{
+    int32_t x = bin();
+
+    if (!(_cal.valid & CAL_GYRO))
+        return;
+    for (int i = 0; i < 3; i++) {
+        _bias[i] = (_fit_a[i] + _fit_b[i] * x) >> 6;    //Q10 to Q4
+        _cal.gyro_bias[i] = (_bias[i] + 8) >> 4;
+    }
+}
+
+/**
+* bin of the temperature now; OUT_TEMP falls 1 LSB per degree C,
+* the bins run the other way, warmer upward
+*/
+int SensorCal::bin()
+{
+    return _cal.temp_origin - _temp + CAL_TEMP_BELOW;
+}
+
+/**
+* moves bin k to k - by, so a temperature outside the bins gets the edge
+* bin; the bins pushed off the other end are dropped
+*/
+void SensorCal::shift_bins(int by)
+{
+    int first = by > 0 ? 0 : CAL_TEMP_BINS - 1;
+    int dir = by > 0 ? 1 : -1;
+
+    _cal.bins = 0;
+    for (int k = first; k >= 0 && k < CAL_TEMP_BINS; k += dir) {
+        int from = k + by;
+        bool keep = from >= 0 && from < CAL_TEMP_BINS;
+        for (int i = 0; i < 3; i++)
+            _cal.bin_bias[k][i] = keep ? _cal.bin_bias[from][i] : 0;
+        _cal.bin_weight[k] = keep ? _cal.bin_weight[from] : 0;
+        if (_cal.bin_weight[k])
+            _cal.bins++;
+    }
+    _cal.temp_origin -= by;
+}
+
+void SensorCal::reset_window()
+{
+    _gn = 0;
+    _an = 0;
+    for (int i = 0; i < 3; i++) {
+        _gsum[i] = 0;
+        _asum[i] = 0;
+        _gmin[i] = 32767;
+        _gmax[i] = -32768;
+        _amin[i] = 32767;
+        _amax[i] = -32768;
+    }
+}
+
+void SensorCal::observe(const int16_t *acc, int n, const int16_t *gyr, int m)
+{
+    for (int k = 0; k < n; k++) {
+        for (int i = 0; i < 3; i++) {
+            int16_t v = acc[k * 3 + i];
+            _asum[i] += v;
+            if (v < _amin[i]) _amin[i] = v;
+            if (v > _amax[i]) _amax[i] = v;
+        }
+        _an++;
+    }
+    for (int k = 0; k < m; k++) {
+        for (int i = 0; i < 3; i++) {
+            int16_t v = gyr[k * 3 + i];
+            _gsum[i] += v;
+            if (v < _gmin[i]) _gmin[i] = v;
+            if (v > _gmax[i]) _gmax[i] = v;
+        }
+        if (++_gn == _window) {
+            window_done();
+            reset_window();
+        }
+    }
+}
+
+/**
+* a window is complete, refines the calibration if the hand was still
+*/
+void SensorCal::window_done()
+{
+    int32_t mean[3];
+
+    if (_an == 0)
+        return;
+    for (int i = 0; i < 3; i++) {
+        if (_gmax[i] - _gmin[i] > _gyro_band || _amax[i] - _amin[i] > _acc_band)
+            return;
+    }
+    for (int i = 0; i < 3; i++)
+        mean[i] = (_gsum[i] << 4) / _gn;
+    if (_cal.valid & CAL_GYRO) {
+        //steady rotation looks still too, but not like the bias
+        for (int i = 0; i < 3; i++) {
+            if (abs(mean[i] - _bias[i]) > _gyro_jump << 4)
+                return;
+        }
+    }
+    //no bin without a temperature, a guess would shift the learned
+    //bins away; the accelerometer does not need one
+    if (_temp_known) {
+        if (_cal.bins == 0)
+            _cal.temp_origin = _temp;
+        int b = bin();
+        if (b < 0 || b >= CAL_TEMP_BINS) {
+            shift_bins(b < 0 ? b : b - (CAL_TEMP_BINS - 1));
+            b = bin();
+        }
+        int w = _cal.bin_weight[b];
+        for (int i = 0; i < 3; i++) {
+            int32_t y = mean[i] >> 2;   //Q4 to Q2
+            _cal.bin_bias[b][i] += (y - _cal.bin_bias[b][i]) / (w + 1);
+        }
+        if (w == 0)
+            _cal.bins++;
+        if (w < CAL_BIN_WEIGHT)
+            _cal.bin_weight[b] = w + 1;
+        _cal.valid |= CAL_GYRO;
+        fit();
+        follow_temperature();
+    }
+
+    for (int i = 0; i < 3; i++) {
+        int32_t a = _asum[i] / _an;
+        int32_t seen = _acc_1g * CAL_ACC_SEEN_PERCENT / 100;
+        if (a > _acc_hi[i]) _acc_hi[i] = a;
+        if (a < _acc_lo[i]) _acc_lo[i] = a;
+        if (_acc_hi[i] >= seen && _acc_lo[i] <= -seen) {
+            _cal.acc_offset[i] = (_acc_hi[i] + _acc_lo[i]) / 2;
+            _cal.acc_scale[i] = (_acc_hi[i] - _acc_lo[i]) / 2;
+            _acc_gain[i] = (_acc_1g << 14) / _cal.acc_scale[i];
+            _cal.valid |= CAL_ACC_X << i;
+        }
+    }
+    _still_windows++;
+}
+
+void SensorCal::correct_gyro(int16_t *gyr, int n)
+{
+    if (!(_cal.valid & CAL_GYRO))
+        return;
+    for (int k = 0; k < n * 3; k += 3) {
+        for (int i = 0; i < 3; i++)
+            gyr[k + i] = clamp16(gyr[k + i] - _cal.gyro_bias[i]);
+    }
+}
+
+void SensorCal::correct_acc(int16_t *acc, int n)
+{
+    for (int i = 0; i < 3; i++) {
+        if (!(_cal.valid & (CAL_ACC_X << i)))
+            continue;
+        for (int k = i; k < n * 3; k += 3)
+            acc[k] = clamp16(((acc[k] - _cal.acc_offset[i]) * _acc_gain[i]) >> 14);
+    }
+}
+
+const CalData &SensorCal::data()
+{
+    return _cal;
+}
+
+uint32_t SensorCal::still_windows()
+{
+    return _still_windows;
+}
@@ -0,0 +1,141 @@
+/**
+* Tap, multi-tap and hold recognizer, see TapGesture.h
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#include "TapGesture.h"
+
+TapGesture::TapGesture(int debounce_ms, int gap_ms, int hold_ms, int max_taps)
+{
+    _head = 0;
+    _tail = 0;
+    _lost = 0;
+    _debounce = debounce_ms * 1000;
+    _gap = gap_ms * 1000;
+    _hold = hold_ms * 1000;
+    _max = max_taps;
+    _pending = false;
+    _pend_level = 0;
+    _pend_t = 0;
+    _last_t = 0;
+    _down = false;
+    _held = false;
+    _open = false;
+    _down_t = 0;
+    _up_t = 0;
+    _count = 0;
+}
+
+void TapGesture::edge(uint8_t level, uint32_t t)
+{
+    int next = (_head + 1) & (TAP_EDGES - 1);
+
+    if (next == _tail) {
+        _lost++;
+        return;
+    }
+    _edges[_head].t = t;
+    _edges[_head].level = level;
+    _head = next;
+}
+
+int TapGesture::poll()
+{
+    uint32_t now = us_ticker_read();
+    int g;
+
+    while (_tail != _head) {
+        const Edge *e = &_edges[_tail];
+        if (_pending && e->t - _last_t < _debounce) {
+            //bounce, the burst goes on
+            _pend_level = e->level;
+            _last_t = e->t;
+            _tail = (_tail + 1) & (TAP_EDGES - 1);
+            continue;
+        }
+        if (_pending) {
+            //timeouts up to the burst come first, then the burst itself;
+            //the edge stays queued until both have been reported
+            g = timeout(_pend_t);
+            if (g != GESTURE_NONE)
+                return g;
+            _pending = false;
+            g = settle(_pend_level, _pend_t);
+            if (g != GESTURE_NONE)
+                return g;
+        }
+        _pending = true;
+        _pend_level = e->level;
+        _pend_t = e->t;
+        _last_t = e->t;
+        _tail = (_tail + 1) & (TAP_EDGES - 1);
+    }
+    if (_pending && now - _last_t >= _debounce) {
+        g = timeout(_pend_t);
+        if (g != GESTURE_NONE)
+            return g;
+        _pending = false;
+        g = settle(_pend_level, _pend_t);
+        if (g != GESTURE_NONE)
+            return g;
+    }
+    //an unsettled burst may still change the level, time stops at it
+    return timeout(_pending ? _pend_t : now);
+}
+
+/**
+* the input settled at level, the burst started at t
+*/
+int TapGesture::settle(uint8_t level, uint32_t t)
+{
+    if (level == _down)
+        return GESTURE_NONE;    //glitch, back where it was
+    if (level) {
+        _down = true;
+        _held = false;
+        _down_t = t;
+        return GESTURE_NONE;
+    }
+    _down = false;
+    if (_held) {
+        _held = false;
+        return GESTURE_NONE;
+    }
+    if (!_open || _count == _max)
+        _count = 0;
+    _count++;
+    _open = true;
+    _up_t = t;
+    return GESTURE_TAP;
+}
+
+/**
+* gestures that are due by time t without a new edge
+*/
+int TapGesture::timeout(uint32_t t)
+{
+    if (_open && (_down ? t - _down_t >= _hold : t - _up_t > _gap)) {
+        _open = false;
+        return GESTURE_SERIES;
+    }
+    if (_down && !_held && t - _down_t >= _hold) {
+        _held = true;
+        return GESTURE_HOLD;
+    }
+    return GESTURE_NONE;
+}
+
+int TapGesture::count()
+{
+    return _count;
+}
+
+bool TapGesture::holding()
+{
+    return _down && _held;
+}
+
+uint32_t TapGesture::lost()
+{
+    return _lost;
+}
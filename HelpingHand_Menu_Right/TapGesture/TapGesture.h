@@ -0,0 +1,106 @@
+/**
+* Tap, multi-tap and hold recognizer for a pinch (pressure) input
+*
+* edge() queues a level change of the input with the us_ticker_read()
+* time it happened, as taken by the pin ISR. poll() classifies the edges
+* from their timestamps alone, so the result does not depend on how late
+* the edges are handed over or how often poll() is called:
+*
+* - edges closer together than the debounce time are one edge, the level
+*   the line settles at decides
+* - a press released before the hold time is a tap, a press that starts
+*   within the gap time of the last tap continues the series, count() is
+*   the number of taps in it (1 to max_taps, then 1 again)
+* - a series ends when the gap time passes without a new press
+* - a press held for the hold time is a hold, it ends the series and is
+*   not counted as a tap
+*
+* A tap is known the debounce time after its release, no window has to
+* run out first.
+*
+* @code
+* TapGesture taps;
+* ...
+* taps.edge(level, t);    //from the ISR event queue
+* int g;
+* while ((g = taps.poll()) != GESTURE_NONE)
+*     if (g == GESTURE_TAP) turn(taps.count());
+* @endcode
+*
+* developed for project HelpingHand as a part of ESE350
+*/
+#ifndef TAPGESTURE_H
+#define TAPGESTURE_H
+
+#include "mbed.h"
+
+#define TAP_EDGES 16            //edges waiting to be classified (power of 2)
+
+//poll() results
+#define GESTURE_NONE 0
+#define GESTURE_TAP 1           //one more tap, count() is the series so far
+#define GESTURE_SERIES 2        //the series ended, count() is its length
+#define GESTURE_HOLD 3          //pressed for the hold time, still down
+
+class TapGesture {
+public:
+    /** Create a recognizer
+     *
+     * @param debounce_ms is how long the input must be steady
+     * @param gap_ms is the longest release between taps of one series
+     * @param hold_ms is how long a press must last to be a hold
+     * @param max_taps is where the tap count starts again at 1
+     */
+    TapGesture(int debounce_ms = 20, int gap_ms = 300, int hold_ms = 600,
+               int max_taps = 5);
+
+    /** the input went to level (1 - pressed) at time t, in time order */
+    void edge(uint8_t level, uint32_t t);
+
+    /** next gesture, GESTURE_NONE when there is nothing new
+     * call until it returns GESTURE_NONE
+     */
+    int poll();
+
+    /** taps in the current or last series */
+    int count();
+
+    /** a hold is in progress */
+    bool holding();
+
+    /** edges dropped because the queue was full */
+    uint32_t lost();
+
+private:
+    struct Edge {
+        uint32_t t;
+        uint8_t level;
+    };
+
+    int settle(uint8_t level, uint32_t t);
+    int timeout(uint32_t t);
+
+    Edge _edges[TAP_EDGES];
+    int _head;
+    int _tail;
+    uint32_t _lost;
+
+    uint32_t _debounce;         //us
+    uint32_t _gap;
+    uint32_t _hold;
+    int _max;
+
+    bool _pending;              //an edge burst is waiting to settle
+    uint8_t _pend_level;
+    uint32_t _pend_t;           //first edge of the burst
+    uint32_t _last_t;           //newest edge of the burst
+
+    bool _down;                 //settled level
+    bool _held;
+    bool _open;                 //a series is running
+    uint32_t _down_t;
+    uint32_t _up_t;
+    int _count;
+};
+
+#endif
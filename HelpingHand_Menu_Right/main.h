@@ -1,5 +1,17 @@
 #include "L3GD20_YY.h" //gyroscope library
 #include "LSM303DLHC.h" //accelerometer library
+#include "HubFrame.h" //framed messages to the hub
+#include "HubInbox.h" //messages from the hub
+#include "Orientation.h" //wrist roll/pitch from gyro and accelerometer
+#include "RotationSpeed.h" //hand rotation speed from the gyro
+#include "SensorCal.h" //sensor offsets, kept in flash
+#include "Quantizer.h" //speed levels
+#include "TapGesture.h" //pinch taps and holds
+#include "PinchForce.h" //light, medium and hard pinches
+#include "EventFifo.h" //ISR events for the main loop
+#include "TimerWheel.h" //software timers on one hardware timeout
+#include "Scheduler.h" //run-to-completion tasks
+#include "AdcScan.h" //analog inputs, scanned in the background
 #include <math.h>
 //bit numbers for Menu
 #define LEFT 1 //means right
@@ -14,13 +26,94 @@
 #define MOTION_LSB 5
 #define MOTION_MSB 6
 #define HAND 7
+//accelerometer sampling
+#define ACC_DATA_RATE LSM303DLHC_ODR_10HZ //menu and game
+#define ACC_PLOT_RATE LSM303DLHC_ODR_100HZ //plot mode, a new sample per telemetry sample
+#define ACC_FULL_SCALE LSM303DLHC_FS_4G //the orientation filter assumes
+                                        //LSM303DLHC_ACC_LSB_PER_G
+#define ACC_PER_DRAIN 1 //accelerometer samples per FIFO drain, sets the drain period
+#define GYRO_FIFO_MARGIN 8 //gyro FIFO levels still free when it is drained
+#define SPEED_WINDOW_MS 100 //|x| acceleration averaged over this long
+#define SPEED_WINDOW 16 //most samples in the window, at the plot rate
+#define SPEED_TAU_MS 50 //rotation speed smoothing
+#define SPEED_ACC_BLEND 0 //accelerometer share of the speed, 0 (gyro only) to 256
+#define SPEED_DPS_PER_G 150 //in the blend, a |x| average of 1 g counts as this rate
+#define GYRO_LSB_PER_DPS (1000000 / L3GX_UDPS_250DPS)
+#define GYRO_SAMPLE_US 5263 //gyro sample period at L3GX_DR_190HZ
+//calibration, refined while the hand is still
+#define CAL_WINDOW_MS 500 //still windows
+#define CAL_STILL_DPS 4 //gyro spread in a still window
+#define CAL_STILL_MG 40 //accelerometer spread in a still window
+#define CAL_SAVE_PERIOD_US 60000000 //changes are written to flash from the menu, 1/min
+#define CAL_DEADLINE_US 1000000
+#define TEMP_PERIOD_US 5000000 //gyro die temperature, moves the bias along its fit
+#define TEMP_DEADLINE_US 1000000
+#define MOTION_BUFFER 64 //gyro samples waiting for the fusion task (power of 2)
+//game loop
+#define COMMAND_PERIOD_MS 520 //one command frame per game move
+//tasks, periods and deadlines after each release
+#define INPUT_PERIOD_US 20000 //ISR events to the gesture and flex state
+#define BATTERY_PERIOD_US 10000000 //battery check, 0.1 Hz
+#define HAPTIC_PULSE_US 1000000 //vibration on a collision
+#define FUSE_DEADLINE_US 50000 //orientation filter after a FIFO drain
+#define COMMAND_DEADLINE_US 20000 //command frame after its period starts
+#define TELEMETRY_DEADLINE_US 100000 //telemetry frames once a batch is ready
+#define HAPTIC_DEADLINE_US 10000 //motor off after the pulse
+#define HUB_DEADLINE_US 5000 //hub messages handled after they arrive
+//hub radio, the XBee modules must be set to the same rate (ATBD)
+#define XBEE_BAUD 57600
+//hub messages, one byte each (Response in helping_hand.py)
+#define HUB_PLAY 0 //menu: play game
+#define HUB_COLLISION 1 //game: vibrate
+#define HUB_PLOT 2 //menu: plot mode
+#define HUB_EXIT 4 //back to the menu, quit from the menu
+//plot mode telemetry
+#define TELEMETRY_RATE_HZ 100 //sensor samples per second
+#define TELEMETRY_PERIOD_US (1000000 / TELEMETRY_RATE_HZ)
+#define TELEMETRY_CHANNELS 8 //accel x,y,z; gyro x,y,z; left, right pressure
+#define TELEMETRY_BUFFER 64 //samples queued for the radio (power of 2)
+#define TELEMETRY_BATCH 10 //samples collected before a frame is sent
+#define TELEMETRY_DELTA 1 //1 - send int8 differences where they fit
+//pinch gestures
+#define TAP_DEBOUNCE_MS 20 //pressure sensor settling time
+#define TAP_GAP_MS 300 //longest release between taps of a series
+#define TAP_HOLD_MS 600 //press that keeps turning until released
+#define TAP_MAX 5 //taps per series, then the count starts again
+//pinch force from the analog pressure levels, 12 bit ADC counts above
+//the released level; set per patient like the speed levels
+#define PINCH_PERIOD_US 5000 //pressure samples, 200 Hz while playing
+#define PINCH_DEADLINE_US 5000
+#define PINCH_LIGHT_COUNTS 300
+#define PINCH_MEDIUM_COUNTS 900
+#define PINCH_HARD_COUNTS 1800
+#define PINCH_HYSTERESIS 100 //below a threshold before the grade drops
+#define PINCH_BASELINE_SHIFT 9 //released level follows over 2^9 samples
+//ISR events, Event.type; arg is the new input level where there is one
+#define EV_PINCH_RIGHT 1
+#define EV_PINCH_LEFT 2
+#define EV_FLEX 3
+#define EVENT_BATCH 8 //events taken from the queue at a time
+//flex sensor debouncing
+#define FLEX_HOLD_US 50000 //second rise this long after the first is a valid flex
+#define FLEX_RELEASE_US 80000 //fall this long after the rise is a valid unflex
 
-//L3GX_GYRO gyro(p_sda, p_scl, chip_addr, datarate, bandwidth, fullscale);
-L3GX_GYRO gyro(p28, p27, 0x6b << 1); //sda 28, scl 27
-LSM303DLHC axcl(p28, p27); //accelerometer
+I2CBus sensorBus(p28, p27); //sda 28, scl 27, shared by gyro and accelerometer
+//L3GX_GYRO gyro(bus, chip_addr, datarate, bandwidth, fullscale);
+L3GX_GYRO gyro(sensorBus, 0x6b << 1, L3GX_DR_190HZ, L3GX_BW_HI, L3GX_FS_250DPS);
+SensorCal calibration(L3GX_UDPS_250DPS, GYRO_SAMPLE_US, LSM303DLHC_ACC_LSB_PER_G,
+                      CAL_WINDOW_MS, CAL_STILL_DPS, CAL_STILL_MG);
+Orientation wrist(GYRO_SAMPLE_US, L3GX_UDPS_250DPS, LSM303DLHC_ACC_LSB_PER_G); //fed calibrated samples
+//speed levels, upper edge of each level in mdps of rotation; set per patient, uneven
+//steps and more levels are fine (the command byte carries up to 7)
+extern const int speedEdges[] = {30000, 60000, 90000, 120000, 150000};
+Quantizer<sizeof(speedEdges) / sizeof(speedEdges[0]), speedEdges,
+          GYRO_LSB_PER_DPS, 5> gearBox;
+RotationSpeed rotation(GYRO_SAMPLE_US, L3GX_UDPS_250DPS, SPEED_TAU_MS); //fed calibrated samples
+LSM303DLHC axcl(sensorBus, ACC_DATA_RATE, ACC_FULL_SCALE, LSM303DLHC_NORMAL); //accelerometer
 
 Serial usb(USBTX,USBRX); 
 Serial xbee1(p13, p14); //tx, rx
+HubFrame hubLink(xbee1); //frames sent to the hub
 DigitalOut rst1(p30); //Digital reset for the XBee, 200ns for reset
 DigitalOut vibrate(p26); //vibration motor
 //for test
@@ -30,50 +123,132 @@ PwmOut led3(LED3);
 //hardware interrupts
 InterruptIn rightTurn(p21); //from pressure sensor
 InterruptIn leftTurn(p22);
+TapGesture rightTaps(TAP_DEBOUNCE_MS, TAP_GAP_MS, TAP_HOLD_MS, TAP_MAX);
+TapGesture leftTaps(TAP_DEBOUNCE_MS, TAP_GAP_MS, TAP_HOLD_MS, TAP_MAX);
+PinchForce rightPinch(PINCH_LIGHT_COUNTS, PINCH_MEDIUM_COUNTS, PINCH_HARD_COUNTS,
+                      PINCH_HYSTERESIS, PINCH_BASELINE_SHIFT);
+PinchForce leftPinch(PINCH_LIGHT_COUNTS, PINCH_MEDIUM_COUNTS, PINCH_HARD_COUNTS,
+                     PINCH_HYSTERESIS, PINCH_BASELINE_SHIFT);
 InterruptIn flex(p24); //from flex sensor
+EventFifo inputEvents; //filled by the ISRs, drained by DispatchEvents()
 
-AnalogIn ain(A0);//battery level detection, 1.8V - 1.95V represents 3.6V - 3.9V
-AnalogIn rightData(A1);
-AnalogIn leftData(A2);
-Ticker timerRight; //valid tap time interval
-Ticker timerLeft;
-Ticker vibrateInterval; 
-Timer flexInterval;
-Timer unflexInterval;
-Ticker timerBattery;//for monitoring battery level
+AdcScan analog;//reads are memory loads once started
+int batteryLevel = analog.add(A0);//battery level detection, 1.8V - 1.95V represents 3.6V - 3.9V
+int rightData = analog.add(A1);//pressure sensors
+int leftData = analog.add(A2);
+TimerWheel timers;//the software timers, one hardware timeout
+WheelTicker sampler(timers);//drains the accelerometer and gyro FIFOs
+Scheduler tasks(timers);//everything else, from the main loop
 
 /*********** Functions *****************/
 void CheckSpeed();
-int GearBox_ax(float speed);
+uint32_t SamplePeriod();
+void SetSpeedWindow();
+void DispatchEvents();
+void FlexEdge(int level, uint32_t t);
+void CheckTaps();
+int TapTurn(TapGesture &taps);
+void SamplePinch();
+void GameCommand();
+void SendCommand();
+void StartTelemetry();
+void StopTelemetry();
+void FlushTelemetry();
+int SendTelemetry();
+void FuseMotion();
+void Vibrate();
 //for test
 void DisplayLED();
 
 /***************** ISRs***********/
 void decode();
-//pressure sensor
-void turnRight();
-void turnLeft();
-void overflowRight();
-void overflowLeft();
-
 //flex sensor 
 void flexed();
 void unflexed();
+//pressure sensors
+void rightPressed();
+void rightReleased();
+void leftPressed();
+void leftReleased();
 //vibration motor
 void vibration();
+//accelerometer and gyro
+void SampleAccel();
+void AccelDrained(int n);
+void GyroDrained(int m);
+void TemperatureRead(int8_t t);
+void QueueMotion(const int16_t *acc, int n, const int16_t *gyr, int m);
+//plot mode
+void SampleTelemetry();
 
 //status check
-void isGameOver();
+void HubReceived();
+void HubDispatch();
+void HubPlay(uint8_t msg);
+void HubCollision(uint8_t msg);
+void HubPlot(uint8_t msg);
+void HubExit(uint8_t msg);
 void backToMenu();
 void CheckBattery();
+void SaveCalibration();
+void ReadTemperature();
+
+/*********** Tasks *******************/
+Task fuseTask(tasks, &FuseMotion, FUSE_DEADLINE_US);//posted by GyroDrained()
+Task commandTask(tasks, &GameCommand, COMMAND_DEADLINE_US);//game mode
+Task telemetryTask(tasks, &FlushTelemetry, TELEMETRY_DEADLINE_US);//posted by SampleTelemetry()
+Task inputTask(tasks, &DispatchEvents, INPUT_PERIOD_US);
+Task hubTask(tasks, &HubDispatch, HUB_DEADLINE_US);//posted by HubReceived()
+Task batteryTask(tasks, &CheckBattery, BATTERY_PERIOD_US);
+Task hapticTask(tasks, &vibration, HAPTIC_DEADLINE_US);//once per pulse
+Task pinchTask(tasks, &SamplePinch, PINCH_DEADLINE_US);//game mode
+Task calTask(tasks, &SaveCalibration, CAL_DEADLINE_US);
+Task tempTask(tasks, &ReadTemperature, TEMP_DEADLINE_US);
+HubInbox hubInbox(xbee1, &HubReceived);//hub messages, from the RX interrupt
 
 /*********** Variables *******************/
-int turnCountRight;
-int turnCountLeft;
 int buf[4];
+int leftForce, rightForce;//hardest pinch grade since the last command
 uint8_t send;
 bool start, quit, debounce;
+uint32_t flexStart;//time of the rise that started a flex
 /* Menu variables */
 bool playGame, plotData;
 char battery_flag;//1 - battery good; 0 - need to be charged
-float x_ax;
\ No newline at end of file
+int x_ax;//|x| acceleration average in mg
+int rotationRate;//rotation speed in 0.1 dps, at the last command
+int8_t gyroTemp;//last good gyro OUT_TEMP, from TemperatureRead()
+/* FIFO drain queued by SampleAccel(), the samples are read into these */
+int16_t drainAcc[LSM303DLHC_FIFO_DEPTH * 3];
+int16_t drainGyr[L3GX_FIFO_DEPTH * 3];
+int drainAccN;//accelerometer samples read, -1 on bus error
+volatile bool draining;//set by SampleAccel(), cleared by GyroDrained()
+/* speed ring buffer of raw |x| samples, filled by GyroDrained() */
+int speedWindow[SPEED_WINDOW];
+int speedHead;
+int speedLen;//samples in the window at the accelerometer rate set
+volatile int speedSum;
+int16_t accLast[3];//newest raw accelerometer sample
+int16_t gyroLast[3];//newest raw gyro sample
+int wristRoll, wristPitch;//hundredths of a degree, from FuseMotion()
+/* gyro samples with the accelerometer sample taken with each, queued by
+   GyroDrained() for FuseMotion() */
+struct Motion {
+    int16_t g[3];
+    int16_t a[3];
+};
+Motion motionBuf[MOTION_BUFFER];
+volatile int motionHead;//written by QueueMotion() only
+volatile int motionTail;//written by FuseMotion() only
+uint32_t motionLost;
+volatile bool telemetryOn;//plot mode, GyroDrained() also calls SampleTelemetry()
+/* plot mode samples, filled by SampleTelemetry(), sent by SendTelemetry() */
+struct Telemetry {
+    uint16_t n;//sample number
+    int16_t v[TELEMETRY_CHANNELS];//mg, 0.1 dps, 12 bit ADC counts
+};
+Telemetry telemetryBuf[TELEMETRY_BUFFER];
+volatile int telemetryHead;//written by SampleTelemetry() only
+volatile int telemetryTail;//written by SendTelemetry() only
+uint16_t telemetryCount;
+uint32_t telemetryLost;
\ No newline at end of file
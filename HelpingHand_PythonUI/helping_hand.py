@@ -13,6 +13,7 @@ import matplotlib.patches as mpatches
 import array
 from collections import deque
 import csv
+import struct
 
 # Global settings
 c_uint8 = ctypes.c_uint8
@@ -26,6 +27,7 @@ assert WINDOWHEIGHT % CELLSIZE == 0, "Window height must be a multiple of cell s
 CELLWIDTH = int(WINDOWWIDTH / CELLSIZE)
 CELLHEIGHT = int(WINDOWHEIGHT / CELLSIZE)
 NUM_OBSTACLES = 40
+XBEE_BAUD = 57600  # must match XBEE_BAUD in the firmware and the XBee ATBD setting
 
 #             R    G    B
 WHITE     = (255, 255, 255)
@@ -88,6 +90,122 @@ class Response( ctypes.Union ):
                ]
     _anonymous_ = ("b")
 
+# Framed glove-to-hub messages (see HubFrame.h in the firmware):
+#   0xA5 0x5A | len | type | seq | time (4) | payload (len) | crc (2)
+FRAME_SYNC = '\xa5\x5a'
+FRAME_HEADER = 9
+FRAME_COMMAND = 0x01
+FRAME_TELEMETRY = 0x02
+
+# Telemetry channels: accel x,y,z (mg), gyro x,y,z (0.1 dps),
+# left and right pressure (12 bit ADC counts)
+TELEMETRY_CHANNELS = 8
+
+# CRC-16/CCITT (poly 0x1021, init 0xffff), as computed by the firmware
+def crc16(data, crc=0xffff):
+    for ch in data:
+        crc ^= ord(ch) << 8
+        for i in range(8):
+            if crc & 0x8000:
+                crc = ((crc << 1) ^ 0x1021) & 0xffff
+            else:
+                crc = (crc << 1) & 0xffff
+    return crc
+
+# One decoded frame, time is the glove's microsecond tick
+class Frame(object):
+    def __init__(self, type, seq, time, payload):
+        self.type = type
+        self.seq = seq
+        self.time = time
+        self.payload = payload
+
+# Streaming frame decoder: feed it whatever the serial port returned and
+# it hands back the complete frames, resyncing on the marker after noise
+# or a bad CRC. Each glove numbers its own frames, so the lost frames are
+# counted per glove: command frames by their hand bit, telemetry (which
+# has no hand bit) as the one glove being plotted.
+class FrameDecoder(object):
+    def __init__(self):
+        self.buf = ''
+        self.lastSeq = {}
+        self.lost = {}
+        self.errors = 0
+        self.sample = None
+
+    # Forget the last sequence numbers, at a mode change: a glove's
+    # frames of the other mode were not meant for this stream
+    def restart(self):
+        self.lastSeq = {}
+        self.sample = None
+
+    # Extend the 16 bit first sample number of a telemetry frame to a
+    # running count, it wraps after 65536 samples (11 min at 100 Hz)
+    def sampleNumber(self, first):
+        if self.sample is None:
+            self.sample = first
+        else:
+            self.sample += (first - self.sample) & 0xffff
+        return self.sample
+
+    def glove(self, type, payload):
+        if type == FRAME_COMMAND and payload:
+            return ord(payload[0]) >> 7   # Command.hand, the top bit
+        return FRAME_TELEMETRY
+
+    def feed(self, data):
+        self.buf += data
+        frames = []
+        while True:
+            start = self.buf.find(FRAME_SYNC)
+            if start < 0:
+                # keep a trailing first marker byte
+                self.buf = self.buf[-1:] if self.buf.endswith(FRAME_SYNC[0]) else ''
+                return frames
+            self.buf = self.buf[start:]
+            if len(self.buf) < FRAME_HEADER:
+                return frames
+            length = ord(self.buf[2])
+            end = FRAME_HEADER + length + 2
+            if len(self.buf) < end:
+                return frames
+            crc = struct.unpack('<H', self.buf[end - 2:end])[0]
+            if crc16(self.buf[2:end - 2]) != crc:
+                self.errors += 1
+                self.buf = self.buf[1:]
+                continue
+            type, seq, time = struct.unpack('<BBI', self.buf[3:FRAME_HEADER])
+            payload = self.buf[FRAME_HEADER:end - 2]
+            glove = self.glove(type, payload)
+            if glove in self.lastSeq:
+                self.lost[glove] = self.lost.get(glove, 0) + ((seq - self.lastSeq[glove] - 1) & 0xff)
+            self.lastSeq[glove] = seq
+            frames.append(Frame(type, seq, time, payload))
+            self.buf = self.buf[end:]
+
+# Unpack a telemetry payload: first sample number, sample period in us,
+# then per sample a mask byte and one field per channel, an int16 where the
+# mask bit is set and an int8 difference to the previous sample otherwise
+def unpackTelemetry(payload):
+    first, period = struct.unpack('<HH', payload[:4])
+    samples = []
+    prev = [0] * TELEMETRY_CHANNELS
+    i = 4
+    while i < len(payload):
+        mask = ord(payload[i])
+        i += 1
+        s = []
+        for ch in range(TELEMETRY_CHANNELS):
+            if mask & (1 << ch):
+                s.append(struct.unpack('<h', payload[i:i + 2])[0])
+                i += 2
+            else:
+                s.append(prev[ch] + struct.unpack('<b', payload[i])[0])
+                i += 1
+        samples.append(s)
+        prev = s
+    return first, period, samples
+
 # The main Player class (inherits from PyGame Rect)
 class Player(pygame.Rect):
     def __init__(self, ident=0, x=0, y=0, size=20, speed=1, ser=None):
@@ -173,11 +291,13 @@ class AIPlayer(Player):
 
 # Plotting class for displaying and saving streaming data from the devices
 class HHPlot:
-    def __init__(self, ser, maxLen):
+    # Scale of each telemetry channel to the plotted unit (g, dps, percent)
+    SCALE = [0.001] * 3 + [0.1] * 3 + [100.0 / 4095] * 2
+
+    def __init__(self, ser, decoder, maxLen):
         self.ser = ser
-        self.ax = deque([0.0]*maxLen)
-        self.ay = deque([0.0]*maxLen)
-        self.az = deque([0.0]*maxLen)
+        self.decoder = decoder
+        self.channels = [deque([0.0]*maxLen) for i in range(TELEMETRY_CHANNELS)]
         self.maxLen = maxLen
         self.csvfile = open('helping_hand_data.csv', 'wb')
         self.csvout = csv.writer(self.csvfile)
@@ -189,29 +309,32 @@ class HHPlot:
             buf.pop()
             buf.appendleft(val)
 
-    def add(self, data):
-        assert(len(data) == 3)
-        self.addToBuf(self.ax, data[0])
-        self.addToBuf(self.ay, data[1])
-        self.addToBuf(self.az, data[2])
+    def add(self, t, data):
+        assert(len(data) == TELEMETRY_CHANNELS)
+        for buf, val in zip(self.channels, data):
+            self.addToBuf(buf, val)
 
-        self.csvout.writerow(data)
-        self.csvfile.flush()
+        self.csvout.writerow([t] + data)
 
-    def update(self, frameNum, a0, a1, a2):
+    def update(self, frameNum, lines):
         try:
-            line = self.ser.readline().strip()
-            data = [ord(val) for val in line.split()]
-
-            if(len(data) == 3):
-                self.add(data)
-                a0.set_data(range(self.maxLen), self.ax)
-                a1.set_data(range(self.maxLen), self.ay)
-                a2.set_data(range(self.maxLen), self.az)
+            # take everything that came in since the last redraw
+            data = self.ser.read(self.ser.inWaiting())
+            for f in self.decoder.feed(data):
+                if f.type != FRAME_TELEMETRY:
+                    continue
+                first, period, samples = unpackTelemetry(f.payload)
+                first = self.decoder.sampleNumber(first)
+                for i, s in enumerate(samples):
+                    t = (first + i) * period / 1e6
+                    self.add(t, [v * k for v, k in zip(s, self.SCALE)])
+            self.csvfile.flush()
+            for line, buf in zip(lines, self.channels):
+                line.set_data(range(self.maxLen), buf)
         except KeyboardInterrupt:
             print('exiting')
 
-        return a0,
+        return lines
 
 # The Main control class for running the game
 class HelpingHand(object):
@@ -224,8 +347,9 @@ class HelpingHand(object):
         pygame.display.set_caption('Helping Hand')
 
         # Set up the XBee connection
-        self.ser = serial.Serial('/dev/ttyAMA0', 9600, timeout=15)
+        self.ser = serial.Serial('/dev/ttyAMA0', XBEE_BAUD, timeout=15)
         self.ser.open()
+        self.decoder = FrameDecoder()
 
         # Create the menu
         menu = cMenu(50, 50, 20, 5, 'vertical', 100, DISPLAYSURF,
@@ -304,19 +428,34 @@ class HelpingHand(object):
 
     # Run the plotting mode
     def run_plotting(self):
-        hhplot = HHPlot(self.ser, 100)
-
-        fig = plt.figure()
-        ax = plt.axes(xlim=(0, 100), ylim=(0, 105))
-        a0, = ax.plot([], [], label='Left Pressure')
-        a1, = ax.plot([], [], label='Right Pressure')
-        a2, = ax.plot([], [], label='Accelerometer')
-        plt.legend((a0, a1, a2), ('Left Pressure', 'Right Pressure', 'Accelerometer'))
+        self.decoder.restart()
+        hhplot = HHPlot(self.ser, self.decoder, 500)
+
+        fig, (accel, gyro, pressure) = plt.subplots(3, sharex=True)
+        accel.set_ylim(-2, 2)
+        gyro.set_ylim(-250, 250)
+        pressure.set_ylim(0, 105)
+        lines = []
+        for ax, unit, names in ((accel, 'g', ('Accel X', 'Accel Y', 'Accel Z')),
+                                (gyro, 'dps', ('Gyro X', 'Gyro Y', 'Gyro Z')),
+                                (pressure, '%', ('Left Pressure', 'Right Pressure'))):
+            ax.set_xlim(0, hhplot.maxLen)
+            ax.set_ylabel(unit)
+            for name in names:
+                l, = ax.plot([], [], label=name)
+                lines.append(l)
+            ax.legend(loc='upper right')
         anim = animation.FuncAnimation(fig, hhplot.update,
-                                       fargs=(a0, a1, a2),
+                                       fargs=(lines,),
                                        interval=50)
         plt.show()
 
+        # plot window closed, take the glove back to the menu
+        if self.ser is not None and self.ser.isOpen():
+            r = Response()
+            r.exit = 1
+            self.ser.write(array.array('B', [r.asByte]).tostring())
+
     # Run the game mode
     def run_game(self, num_obstacles, players):
         # Draw random obstacles
@@ -334,12 +473,16 @@ class HelpingHand(object):
         self.players = [self.player1, self.player2]
         self.drawPlayers()
 
+        self.decoder.restart()
         direction = RIGHT
         while True: # main game loop
             if self.ser is not None and self.ser.isOpen():
-                # Process the command coming from the device and perform a move
-                c = self.getCommand(self.ser.readline().strip())
-                if c is not None:
+                # Process the commands coming from the devices and perform the moves
+                data = self.ser.read(max(1, self.ser.inWaiting()))
+                for f in self.decoder.feed(data):
+                    if f.type != FRAME_COMMAND:
+                        continue
+                    c = self.getCommand(ord(f.payload[0]))
                     dir = c.action
                     if c.left:
                         dir = 2
@@ -416,13 +559,10 @@ class HelpingHand(object):
         if r == 3:
             return RIGHT
 
-    # Parse the command input coming from the devices
-    def getCommand(self, input):
+    # Parse the command byte of a frame coming from the devices
+    def getCommand(self, value):
         c = Command()
-        try:
-            c.asByte = ord(input)
-        except:
-            return None
+        c.asByte = value
         if DEBUG:
             print ' ------ '
             print "hand:    %i" % c.hand